@@ -1,17 +1,27 @@
 {
+  'variables': {
+    # store feature values as float (8-byte nodes), see SVM_COMPACT_NODES in svm.h
+    'svm_compact_nodes%': 'false'
+  },
   'targets': [
     {
       'target_name': 'addon',
       'sources': [
         './src/libsvm/svm.cpp',
         './src/addon.cc',
-        './src/node-svm/node-svm.cc'
+        './src/node-svm/node-svm.cc',
+        './src/node-svm/dataset.cc'
       ],
       "include_dirs" : [
         "<!(node -e \"require('nan')\")"
       ],
       'cflags': ['-Wall', '-O3', '-fPIC', '-c'],
-      "cflags_cc!": ["-fno-rtti", "-fno-exceptions"]
+      "cflags_cc!": ["-fno-rtti", "-fno-exceptions"],
+      'conditions': [
+        ['svm_compact_nodes=="true"', {
+          'defines': ['SVM_COMPACT_NODES']
+        }]
+      ]
     }
   ]
 }
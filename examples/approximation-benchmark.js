@@ -0,0 +1,69 @@
+/**
+  Measure RBF training speed with and without an approximate kernel feature map.
+
+  data : non-linear boundary in 10 dimensions, `n` training and `nTest` test samples
+
+  NOTE : Nystroem training solves a linear SVM on `rank` features by coordinate descent,
+  exact training runs SMO on the whole n x n kernel matrix: the gap grows with n.
+*/
+'use strict';
+
+var BaseSVM = require('../lib/core/base-svm');
+var kernelTypes = require('../lib/core/kernel-types');
+var approximationTypes = require('../lib/core/approximation-types');
+var d = 10, n = 8000, nTest = 2000, rank = 100;
+
+var seed = 1;
+function random() {
+    seed = (seed * 16807) % 2147483647;
+    return seed / 2147483647;
+}
+
+var x = new Float64Array((n + nTest) * d),
+    y = new Int32Array(n + nTest);
+for (var i = 0; i < n + nTest; i++) {
+    for (var k = 0; k < d; k++) {
+        x[i * d + k] = 2 * random() - 1;
+    }
+    var z = x.subarray(i * d, (i + 1) * d);
+    y[i] = Math.sin(3 * z[0]) + z[1] * z[1] - 0.5 + 0.4 * z[2] * z[3] + 0.4 * (random() - 0.5) > 0 ? 1 : 0;
+}
+
+function seconds(start) {
+    var elapsed = process.hrtime(start);
+    return elapsed[0] + elapsed[1] / 1e9;
+}
+
+// train on the first n samples, returns the training time and the accuracy on the others
+function train(approximation) {
+    var clf = new BaseSVM();
+    var config = { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, approximation: approximation, approximationRank: rank };
+    var start = process.hrtime();
+    return clf.trainMatrix(x.subarray(0, n * d), n, d, y.subarray(0, n), config).then(function () {
+        var elapsed = seconds(start);
+        var correct = 0;
+        for (var i = n; i < n + nTest; i++) {
+            if (clf.predictSync(Array.prototype.slice.call(x, i * d, (i + 1) * d)) === y[i]) {
+                correct++;
+            }
+        }
+        return { time: elapsed, accuracy: correct / nTest };
+    });
+}
+
+function report(name, result) {
+    console.log('%s: trained in %ss, accuracy %s%', name, result.time.toFixed(3), (result.accuracy * 100).toFixed(1));
+    return result;
+}
+
+var exact;
+train(approximationTypes.NONE)
+    .then(function (result) {
+        exact = report('exact     ', result);
+        return train(approximationTypes.NYSTROEM);
+    })
+    .then(function (result) {
+        var approximate = report('nystroem ' + rank, result);
+        console.log('speedup: %sx', (exact.time / approximate.time).toFixed(2));
+    })
+    .done();
@@ -0,0 +1,64 @@
+/**
+  Measure RBF prediction speed on the libsvm guide dataset.
+  See http://www.csie.ntu.edu.tw/~cjlin/papers/guide/guide.pdf, p.9.
+
+  training set : svmguide1.ds
+  test set     : svmguide1.t.ds (loaded once, predicted `rounds` times)
+
+  NOTE : No scaling, so that (almost) every training example ends up being a support vector.
+  Each prediction computes K(x, sv) for all of them: with ||sv||^2 stored in the model,
+  |x - sv|^2 only costs one dot product per support vector. Both paths are timed.
+*/
+'use strict';
+
+var addon = require('../build/Release/addon');
+var BaseSVM = require('../lib/core/base-svm');
+var kernelTypes = require('../lib/core/kernel-types');
+var read = require('../lib/util/read-dataset');
+var trainingFile = './examples/datasets/svmguide1.ds';
+var testingFile = './examples/datasets/svmguide1.t.ds';
+var rounds = 5;
+
+var clf = new BaseSVM();
+
+function seconds(start) {
+    var elapsed = process.hrtime(start);
+    return elapsed[0] + elapsed[1] / 1e9;
+}
+
+// predict every row `rounds` times, returns the elapsed seconds
+function time(predict, rows) {
+    var start = process.hrtime();
+    for (var round = 0; round < rounds; round++) {
+        rows.forEach(function (row) {
+            predict(row[0]);
+        });
+    }
+    return seconds(start);
+}
+
+var start = process.hrtime();
+clf.trainFromFile(trainingFile, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.25 })
+    .then(function (model) {
+        console.log('trained in %ss: %d support vectors', seconds(start).toFixed(3), model.l);
+        return read(testingFile).then(function (rows) {
+            // the trained model, with and without the stored ||sv||^2
+            var stored = new addon.NodeSvm(), plain = new addon.NodeSvm();
+            stored.loadFromModel(model);
+            plain.loadFromModel(model, false);
+            var differ = rows.filter(function (row) {
+                return stored.predict(row[0]) !== plain.predict(row[0]);
+            }).length;
+            console.log('%d of %d predictions differ', differ, rows.length);
+            var predictions = rounds * rows.length;
+            var report = function (name, elapsed) {
+                console.log('%s: %d predictions in %ss (%sus per prediction)',
+                    name, predictions, elapsed.toFixed(3), (elapsed / predictions * 1e6).toFixed(1));
+                return elapsed;
+            };
+            var withoutNorms = report('without ||sv||^2', time(function (x) { return plain.predict(x); }, rows));
+            var withNorms = report('with ||sv||^2   ', time(function (x) { return stored.predict(x); }, rows));
+            console.log('speedup: %sx', (withoutNorms / withNorms).toFixed(2));
+        });
+    })
+    .done();
@@ -31,7 +31,7 @@ function evaluate(logger, options) {
 
     return Q.all([
         readModel(modelPath),
-        readTestset(testsetPath)
+        readTestset(testsetPath, options.cache !== false)
     ]).spread(function (model, testset) {
         var svm = new SVM({}, model);
         var report = svm.evaluate(testset);
@@ -74,7 +74,7 @@ function readModel(file) {
        });
 }
 
-function readTestset(file) {
+function readTestset(file, cache) {
     return checkFileExists(file)
         .then(function (exists) {
             if (!exists) {
@@ -82,7 +82,7 @@ function readTestset(file) {
             }
         })
         .then(function () {
-            return read(file);
+            return read(file, { cache: cache });
         });
 }
 
@@ -95,7 +95,9 @@ function checkFileExists(file){
 // -------------------
 
 evaluate.line = function (logger, argv) {
-    var options = cli.readOptions(argv);
+    var options = cli.readOptions({
+        'cache': { type: Boolean }
+    }, argv);
     if (options.argv.remain[1]){
         options.pathToModel = options.argv.remain[1];
         if (options.argv.remain[2]){
@@ -12,6 +12,8 @@ var _s = require('mout/string');
 var defaultConfig = require('../core/config');
 var svmTypes = require('../core/svm-types');
 var kernelTypes = require('../core/kernel-types');
+var approximationTypes = require('../core/approximation-types');
+var cachePolicies = require('../core/cache-policies');
 var SVM = require('../core/svm');
 var createError = require('../util/create-error');
 var cli = require('../util/cli');
@@ -19,6 +21,8 @@ var read = require('../util/read-dataset');
 
 var svmTypesString = _o.keys(svmTypes);
 var kernelTypesString = _o.keys(kernelTypes);
+var approximationTypesString = _o.keys(approximationTypes);
+var cachePoliciesString = _o.keys(cachePolicies);
 
 function train(logger, options) {
     var config;
@@ -27,6 +31,8 @@ function train(logger, options) {
     }
     var datasetPath = path.resolve(options.cwd || '.', options.pathToDataset);
     delete options.pathToDataset;
+    var cache = options.cache !== false;
+    delete options.cache;
 
     var defaults = defaultConfig();
     var interactive = _o.has(options, 'interactive') ? !!options.interactive:  defaults.interactive;
@@ -143,7 +149,7 @@ function train(logger, options) {
             if (!good){ return null; }
 
             logger.info('train', 'read dataset file');
-            return read(datasetPath)
+            return read(datasetPath, { cache: cache })
                 .then(function (dataset) {
                     var svm = new SVM(config);
                     logger.info('train', 'start training');
@@ -182,6 +188,12 @@ function train(logger, options) {
                         else if (key === 'kernelType'){
                             bestConf.kernelType = kernelTypesString[value];
                         }
+                        else if (key === 'approximation'){
+                            bestConf.approximation = approximationTypesString[value];
+                        }
+                        else if (key === 'cachePolicy'){
+                            bestConf.cachePolicy = cachePoliciesString[value];
+                        }
                         else {
                             var cKey = _s.camelCase('render-' + key.replace(/_/g, '-'));
                             bestConf[cKey] = req(key, config);
@@ -240,7 +252,7 @@ function askKernelType(logger, defaultValue) {
         'message': 'Kernel',
         'default': kernelTypesString[defaultValue || 0],
         'type': 'list',
-        'choices': kernelTypesString
+        'choices': _a.difference(kernelTypesString, ['PRECOMPUTED']) // requires a kernel matrix
     }).then(function (answer) { return kernelTypes[answer]; });
 }
 function askDegree(logger, defaultValue) {
@@ -354,6 +366,12 @@ function askConfirmation(logger, config){
         else if (key === 'kernelType'){
             cleanConfig.kernelType = kernelTypesString[value];
         }
+        else if (key === 'approximation'){
+            cleanConfig.approximation = approximationTypesString[value];
+        }
+        else if (key === 'cachePolicy'){
+            cleanConfig.cachePolicy = cachePoliciesString[value];
+        }
         else if (key === 'cwd' ||
             key === 'argv' ||
             key === 'interactive' ||
@@ -468,9 +486,20 @@ function req(param, config){
         case 'cacheSize':
         case 'shrinking':
         case 'probability':
+        case 'threads':
+        case 'halfPrecisionCache':
+        case 'cachePolicy':
+        case 'shareKernel':
+        case 'kernelStoreSize':
             return true;
         case 'retainedVariance':
             return config.reduce;
+        case 'fastKernelMath':
+            return config.kernelType === kernelTypes.RBF ||
+                config.kernelType === kernelTypes.SIGMOID;
+        case 'approximationRank':
+        case 'approximationSeed':
+            return !!config.approximation;
         default :
             return false;
     }
@@ -498,9 +527,19 @@ train.options = function (argv) {
         'reduce': { type: Boolean },
         'retained-variance': { type: Number },
         'eps': { type: Number },
-        'cache-size': { type: Number },
+        'cache-size': { type: [Number, String] },
         'shrinking': { type: Boolean },
         'probability': { type: Boolean },
+        'fast-kernel-math': { type: Boolean },
+        'threads': { type: Number },
+        'half-precision-cache': { type: Boolean },
+        'cache-policy': { type: String },
+        'share-kernel': { type: Boolean },
+        'kernel-store-size': { type: Number },
+        'approximation': { type: String },
+        'approximation-rank': { type: Number },
+        'approximation-seed': { type: Number },
+        'cache': { type: Boolean },
         'color': { type: Boolean },
         'interactive': { type: Boolean, shorthand: 'i' }
     }, argv);
@@ -510,6 +549,12 @@ train.options = function (argv) {
     if (options.kernelType){
         options.kernelType = kernelTypes[options.kernelType] || kernelTypes.LINEAR;
     }
+    if (options.approximation){
+        options.approximation = approximationTypes[options.approximation] || approximationTypes.NONE;
+    }
+    if (options.cachePolicy){
+        options.cachePolicy = cachePolicies[options.cachePolicy] || cachePolicies.LRU;
+    }
 
     return options;
 };
@@ -0,0 +1,8 @@
+'use strict';
+
+// kernel approximations, see `approximation` option
+module.exports = {
+    NONE : 0,
+    NYSTROEM : 1,       // landmarks sampled among training examples (any kernel but PRECOMPUTED)
+    RANDOM_FOURIER : 2  // random Fourier features (RBF kernel only)
+};
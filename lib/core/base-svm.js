@@ -7,8 +7,11 @@ var _o = require('mout/object');
 var _a = require('mout/array');
 
 var addon = require('../../build/Release/addon');
+var Dataset = require('./dataset');
 var svmTypes = require('./svm-types');
 var kernelTypes = require('./kernel-types');
+var approximationTypes = require('./approximation-types');
+var cachePolicies = require('./cache-policies');
 var createError = require('../util/create-error');
 
 function BaseSVM(clf){
@@ -23,14 +26,94 @@ BaseSVM.restore = function(model){
    return new BaseSVM(clf);
 };
 
+/*
+ `dataset` is either a list of [X,y] tuples or a `Dataset` (whose rows are shared, not copied).
+ With `kernelStoreSize` (MB), trainings on a `Dataset` (or its subsets) with the same kernel
+ share their kernel columns, e.g. while searching for the best C, nu or epsilon.
+ */
 BaseSVM.prototype.train = function(dataset, config){
+    if (dataset instanceof Dataset){
+        return this._train(config, function (clf, done) {
+            clf.trainAsync(dataset._dataset, dataset._indexes, done);
+        });
+    }
     var dims = numeric.dim(dataset);
     assert(dims[0]>0 && dims[1] === 2 && dims[2]>0 , 'dataset must be a list of [X,y] tuples');
 
+    return this._train(config, function (clf, done) {
+        clf.trainAsync(dataset, done);
+    });
+};
+
+/*
+ Train from a dense row-major matrix of nbRows x nbFeatures (`Float64Array` or `Float32Array`)
+ and its labels (`Float64Array`, `Float32Array` or `Int32Array`).
+ The addon reads the typed arrays' backing store directly.
+ */
+BaseSVM.prototype.trainMatrix = function(x, nbRows, nbFeatures, y, config){
+    assert(x instanceof Float64Array || x instanceof Float32Array, 'x must be a Float64Array or a Float32Array');
+    assert(nbRows > 0 && nbFeatures > 0 && x.length === nbRows * nbFeatures, 'x must be a nbRows x nbFeatures matrix');
+    assert(y instanceof Float64Array || y instanceof Float32Array || y instanceof Int32Array, 'y must be a typed array');
+    assert(y.length === nbRows, 'y must contain one label per row');
+
+    return this._train(config, function (clf, done) {
+        clf.trainMatrixAsync(x, nbRows, nbFeatures, y, done);
+    });
+};
+
+/*
+ Train from a sparse matrix in CSR format: non-zeros of row `i` are `values[indptr[i]..indptr[i+1]-1]`
+ and their (0-based, sorted) column indexes are `indices[indptr[i]..indptr[i+1]-1]`.
+ */
+BaseSVM.prototype.trainCsr = function(indptr, indices, values, y, config){
+    assert(indptr instanceof Int32Array && indptr.length > 1, 'indptr must be an Int32Array of nbRows + 1 elements');
+    assert(indices instanceof Int32Array && indices.length === indptr[indptr.length - 1], 'indices must be an Int32Array of nnz elements');
+    assert((values instanceof Float64Array || values instanceof Float32Array) && values.length === indices.length, 'values must be a Float64Array or a Float32Array of nnz elements');
+    assert(y instanceof Float64Array || y instanceof Float32Array || y instanceof Int32Array, 'y must be a typed array');
+    assert(y.length === indptr.length - 1, 'y must contain one label per row');
+
+    return this._train(config, function (clf, done) {
+        clf.trainCsrAsync(indptr, indices, values, y, done);
+    });
+};
+
+/*
+ Train from a dataset file (libsvm format, or CSV with the label in the first column
+ when the file name ends with `.csv`). The file is read and parsed by the addon in a worker
+ thread: examples never go through the JS heap.
+ */
+BaseSVM.prototype.trainFromFile = function(path, config){
+    assert(typeof path === 'string', 'path must be a string');
+
+    return this._train(config, function (clf, done) {
+        clf.trainFromFileAsync(path, done);
+    });
+};
+
+/*
+ Train with a precomputed kernel from `gram`, the n x n row-major `Float64Array` of the kernel values
+ K(x_i, x_j) of every pair of training samples, and their labels (`Float64Array`, `Float32Array` or `Int32Array`).
+ The matrix is read in place by the addon, it is never copied.
+ Support vectors of the resulting model are reported as `[[i], coefs]` where `i` is the (0-based)
+ index of the training sample (see `predictPrecomputedSync`).
+ */
+BaseSVM.prototype.trainPrecomputed = function(gram, n, y, config){
+    assert(gram instanceof Float64Array, 'gram must be a Float64Array');
+    assert(n > 0 && gram.length === n * n, 'gram must be a n x n matrix');
+    assert(y instanceof Float64Array || y instanceof Float32Array || y instanceof Int32Array, 'y must be a typed array');
+    assert(y.length === n, 'y must contain one label per sample');
+
+    config = _o.merge(config || {}, { kernelType: kernelTypes.PRECOMPUTED });
+    return this._train(config, function (clf, done) {
+        clf.trainPrecomputedAsync(gram, n, y, done);
+    }, true);
+};
+
+BaseSVM.prototype._train = function(config, trainAsync, precomputed){
     var params = _o.merge({
         svmType: svmTypes.C_SVC,
         kernelType: kernelTypes.RBF,
-        degree: 3,
+        degree: 3,
         gamma: 1,
         r: 0,
         c: 1,
@@ -39,9 +122,29 @@ BaseSVM.prototype.train = function(dataset, config){
         cacheSize: 100,
         eps: 1e-3,
         shrinking: true,
-        probability: false
+        probability: false,
+        fastKernelMath: false,
+        threads: 1,
+        halfPrecisionCache: false,
+        cachePolicy: cachePolicies.LRU,
+        shareKernel: true,
+        kernelStoreSize: 0,
+        approximation: approximationTypes.NONE,
+        approximationRank: 100,
+        approximationSeed: 0
     }, config || {});
 
+    if ((params.kernelType === kernelTypes.PRECOMPUTED) !== !!precomputed) {
+        return Q.reject(createError('Precomputed kernels require a kernel matrix (see trainPrecomputed)', 'EINVPARAMS'));
+    }
+    if (params.kernelType === kernelTypes.PRECOMPUTED && params.probability) {
+        return Q.reject(createError('Probability estimates are not supported for precomputed kernels', 'EINVPARAMS'));
+    }
+    if (params.approximation !== approximationTypes.NONE &&
+        (params.kernelType === kernelTypes.PRECOMPUTED ||
+         params.approximation === approximationTypes.RANDOM_FOURIER && params.kernelType !== kernelTypes.RBF)) {
+        return Q.reject(createError('Kernel can not be approximated (random Fourier features require a RBF kernel)', 'EINVPARAMS'));
+    }
     var self = this;
     var deferred = Q.defer();
     this._clf = new addon.NodeSvm();
@@ -49,22 +152,72 @@ BaseSVM.prototype.train = function(dataset, config){
     if (err) {
         return Q.reject(createError('Bad parameters', 'EINVPARAMS'));
     }
-    this._clf.trainAsync(dataset, function () {
+    trainAsync(this._clf, function (trainingErr) {
+        if (trainingErr) {
+            // invalid dataset (detected while building the problem in the worker thread)
+            return deferred.reject(createError(trainingErr.message, 'EINVDATASET'));
+        }
         var model = self._clf.getModel();
         deferred.resolve(model);
     });
     return deferred.promise;
 };
 
+// precomputed kernel models only predict from kernel values (see `predictPrecomputedSync`)
+function assertNotPrecomputed(clf){
+    assert(clf.getKernelType() !== kernelTypes.PRECOMPUTED, 'precomputed kernel models predict from kernel values (see predictPrecomputedSync)');
+}
 
 BaseSVM.prototype.predictSync = function(inputs) {
     assert(!!this._clf, 'train classifier first');
+    assertNotPrecomputed(this._clf);
     var dims = numeric.dim(inputs);
     assert((dims[0] || 0) > 0 && (dims[1] || 0) === 0 , 'input must be a 1d array');
     return this._clf.predict(inputs);
 };
+// predict each row of a CSR matrix (see `trainCsr`)
+BaseSVM.prototype.predictCsrSync = function(indptr, indices, values) {
+    assert(!!this._clf, 'train classifier first');
+    assertNotPrecomputed(this._clf);
+    assert(indptr instanceof Int32Array && indptr.length > 1, 'indptr must be an Int32Array of nbRows + 1 elements');
+    assert(indices instanceof Int32Array && indices.length === indptr[indptr.length - 1], 'indices must be an Int32Array of nnz elements');
+    assert((values instanceof Float64Array || values instanceof Float32Array) && values.length === indices.length, 'values must be a Float64Array or a Float32Array of nnz elements');
+    return this._clf.predictCsr(indptr, indices, values);
+};
+/*
+ Predict with a model trained by `trainPrecomputed`: `kernelValues` is the nbRows x nbSupportVectors
+ row-major `Float64Array` of the kernel values K(x, sv) of each sample to predict and each support vector
+ of the model, in model order.
+ */
+BaseSVM.prototype.predictPrecomputedSync = function(kernelValues, nbRows) {
+    assert(!!this._clf, 'train classifier first');
+    assert(this._clf.getKernelType() === kernelTypes.PRECOMPUTED, 'model was not trained from a kernel matrix (see trainPrecomputed)');
+    assert(kernelValues instanceof Float64Array, 'kernelValues must be a Float64Array');
+    assert(nbRows > 0 && nbRows === (nbRows | 0), 'nbRows must be a positive integer');
+    assert(kernelValues.length === nbRows * this._clf.getNbSupportVectors(), 'kernelValues must be a nbRows x nbSupportVectors matrix');
+    return this._clf.predictPrecomputed(kernelValues, nbRows);
+};
+/*
+ Predict every example of a dataset file (see `trainFromFile`).
+ Resolve `{ predictions: [...], expected: [...] }` where `expected` are the labels read from the file.
+ */
+BaseSVM.prototype.predictFile = function(path){
+    assert(!!this._clf, 'train classifier first');
+    assertNotPrecomputed(this._clf);
+    assert(typeof path === 'string', 'path must be a string');
+    var deferred = Q.defer();
+
+    this._clf.predictFileAsync(path, function (err, predictions, expected) {
+        if (err) {
+            return deferred.reject(createError(err.message, 'EINVDATASET'));
+        }
+        deferred.resolve({ predictions: predictions, expected: expected });
+    });
+    return deferred.promise;
+};
 BaseSVM.prototype.predict = function(inputs){
     assert(!!this._clf, 'train classifier first');
+    assertNotPrecomputed(this._clf);
     var dims = numeric.dim(inputs);
     assert((dims[0] || 0) > 0 && (dims[1] || 0) === 0 , 'input must be a 1d array');
     var deferred = Q.defer();
@@ -81,6 +234,7 @@ BaseSVM.prototype.predict = function(inputs){
  */
 BaseSVM.prototype.predictProbabilitiesSync = function(inputs) {
     assert(!!this._clf, 'train classifier first');
+    assertNotPrecomputed(this._clf);
     var dims = numeric.dim(inputs);
     assert((dims[0] || 0) > 0 && (dims[1] || 0) === 0 , 'input must be a 1d array');
 
@@ -92,6 +246,7 @@ BaseSVM.prototype.predictProbabilitiesSync = function(inputs) {
 };
 BaseSVM.prototype.predictProbabilities = function(inputs) {
     assert(!!this._clf, 'train classifier first');
+    assertNotPrecomputed(this._clf);
     var dims = numeric.dim(inputs);
     assert((dims[0] || 0) > 0 && (dims[1] || 0) === 0 , 'input must be a 1d array');
     var self = this;
@@ -110,5 +265,19 @@ BaseSVM.prototype.isTrained = function(){
     return !!this._clf? this._clf.isTrained(): false;
 };
 
+/*
+ Kernel cache statistics of the last training:
+   - cacheHits, cacheMisses, cacheHitRate: kernel columns requested by the solver
+   - cacheEvictions: columns evicted to make room for others
+   - columnsRecomputed: columns computed again after being evicted (or dropped by shrinking)
+   - cacheBytes: largest cache allocated
+   - kernelEvaluations: kernel values computed
+   - maxCacheError: largest rounding error of the cached kernel values (`halfPrecisionCache` only)
+ */
+BaseSVM.prototype.getTrainingStats = function(){
+    assert(!!this._clf, 'not trained yet');
+    return this._clf.getTrainingStats();
+};
+
 
 module.exports = BaseSVM;
\ No newline at end of file
@@ -0,0 +1,7 @@
+'use strict';
+
+// kernel cache eviction policies, see `cachePolicy` option
+module.exports = {
+    LRU : 0,        // least recently used columns first
+    SHRINKING : 1   // columns of shrunk variables first, then of bounded ones (free SVs last)
+};
@@ -11,6 +11,8 @@ var rc = require('../util/read-config');
 var defaults = require('./default-options');
 var svmTypes = require('./svm-types');
 var kernelTypes = require('./kernel-types');
+var approximationTypes = require('./approximation-types');
+var cachePolicies = require('./cache-policies');
 
 var cachedConfigs = {};
 
@@ -62,6 +64,12 @@ function checkConfig(config) {
     if (_l.isString(config.kernelType)){
         config.kernelType = kernelTypes[config.kernelType];
     }
+    if (_l.isString(config.approximation)){
+        config.approximation = approximationTypes[config.approximation];
+    }
+    if (_l.isString(config.cachePolicy)){
+        config.cachePolicy = cachePolicies[config.cachePolicy];
+    }
     // parameter gamma used for POLY, RBF, and SIGMOID kernels
     if (config.kernelType === kernelTypes.POLY ||
         config.kernelType === kernelTypes.RBF ||
@@ -0,0 +1,114 @@
+'use strict';
+
+var assert = require('assert');
+var numeric = require('numeric');
+
+var addon = require('../../build/Release/addon');
+
+/*
+ Training examples converted once by the addon and shared by any number of trainings
+ (see `BaseSVM.train`), without being copied again.
+ Rows can be appended at any time: trainings already done are not affected.
+ */
+function Dataset(rows){
+    this._dataset = new addon.Dataset();
+    if (rows){
+        this.appendRows(rows);
+    }
+}
+
+// append a list of [X,y] tuples
+Dataset.prototype.appendRows = function(rows){
+    assert(!this._indexes, 'can not append rows to a subset');
+    var dims = numeric.dim(rows);
+    assert(dims[0]>0 && dims[1] === 2 && dims[2]>0 , 'rows must be a list of [X,y] tuples');
+    this._dataset.appendRows(rows);
+    return this;
+};
+
+// append a dense row-major matrix (see `BaseSVM.trainMatrix`)
+Dataset.prototype.appendMatrix = function(x, nbRows, nbFeatures, y){
+    assert(!this._indexes, 'can not append rows to a subset');
+    assert(x instanceof Float64Array || x instanceof Float32Array, 'x must be a Float64Array or a Float32Array');
+    assert(nbRows > 0 && nbFeatures > 0 && x.length === nbRows * nbFeatures, 'x must be a nbRows x nbFeatures matrix');
+    assert(y instanceof Float64Array || y instanceof Float32Array || y instanceof Int32Array, 'y must be a typed array');
+    assert(y.length === nbRows, 'y must contain one label per row');
+    this._dataset.appendMatrix(x, nbRows, nbFeatures, y);
+    return this;
+};
+
+// append a CSR matrix (see `BaseSVM.trainCsr`)
+Dataset.prototype.appendCsr = function(indptr, indices, values, y){
+    assert(!this._indexes, 'can not append rows to a subset');
+    assert(indptr instanceof Int32Array && indptr.length > 1, 'indptr must be an Int32Array of nbRows + 1 elements');
+    assert(indices instanceof Int32Array && indices.length === indptr[indptr.length - 1], 'indices must be an Int32Array of nnz elements');
+    assert((values instanceof Float64Array || values instanceof Float32Array) && values.length === indices.length, 'values must be a Float64Array or a Float32Array of nnz elements');
+    assert(y instanceof Float64Array || y instanceof Float32Array || y instanceof Int32Array, 'y must be a typed array');
+    assert(y.length === indptr.length - 1, 'y must contain one label per row');
+    this._dataset.appendCsr(indptr, indices, values, y);
+    return this;
+};
+
+/*
+ Append the examples of a dataset file (libsvm format, or CSV with a `.csv` extension).
+ With `cache`, parsed examples are saved next to the file (`<file>.svmcache`) and
+ mapped back by later calls instead of parsing the file again, as long as the file is unchanged.
+ */
+Dataset.prototype.appendFile = function(path, cache){
+    assert(!this._indexes, 'can not append rows to a subset');
+    assert(typeof path === 'string', 'path must be a string');
+    this._dataset.appendFile(path, !!cache);
+    return this;
+};
+
+Dataset.prototype.size = function(){
+    return this._indexes ? this._indexes.length : this._dataset.size();
+};
+
+Dataset.prototype.nbFeatures = function(){
+    return this._dataset.getNbFeatures();
+};
+
+// list of [X,y] tuples, X being dense
+Dataset.prototype.toArray = function(){
+    var rows = this._dataset.toArray();
+    if (!this._indexes){
+        return rows;
+    }
+    return Array.prototype.map.call(this._indexes, function (i) {
+        return rows[i];
+    });
+};
+
+/*
+ View of rows `indexes` (array or Int32Array): rows are not copied.
+ */
+Dataset.prototype.subset = function(indexes){
+    assert(indexes.length > 0, 'indexes must not be empty');
+    var parentIndexes = this._indexes;
+    var subset = Object.create(Dataset.prototype);
+    subset._dataset = this._dataset;
+    if (!parentIndexes && indexes instanceof Int32Array){
+        subset._indexes = indexes;
+        return subset;
+    }
+    subset._indexes = new Int32Array(indexes.length);
+    for (var i = 0; i < indexes.length; i++){
+        subset._indexes[i] = parentIndexes ? parentIndexes[indexes[i]] : indexes[i];
+    }
+    return subset;
+};
+
+/*
+ Shuffle rows into `kFold` folds for cross-validation (each class spread evenly among folds if `stratified`).
+ Return `kFold` { train, test } objects where `train` and `test` are Int32Array of row indexes (see `subset`).
+ With kFold = 1, the entire dataset is used for both training and testing.
+ */
+Dataset.prototype.splitFolds = function(kFold, stratified){
+    assert(!this._indexes, 'can not split a subset');
+    kFold = kFold || 5;
+    assert(kFold > 0 && kFold <= this.size(), 'kFold parameter must be <= n');
+    return this._dataset.splitFolds(kFold, !!stratified);
+};
+
+module.exports = Dataset;
@@ -2,6 +2,8 @@
 
 var types = require('./svm-types');
 var kernels = require('./kernel-types');
+var approximations = require('./approximation-types');
+var cachePolicies = require('./cache-policies');
 
 module.exports = {
     // svm type
@@ -12,6 +14,9 @@ module.exports = {
     'degree': [2,3,4],                        // for POLY kernel
     'gamma': [0.001, 0.01, 0.5], // for POLY, RBF and SIGMOID kernels
     'r': [0.125, 0.5, 0, 1],            // for POLY and SIGMOID kernels
+    'approximation': approximations.NONE,     // train a linear model on an approximate kernel feature map
+    'approximation-rank': 100,                // number of landmarks (NYSTROEM) or random features (RANDOM_FOURIER)
+    'approximation-seed': 0,                  // seed of the landmarks / random features sampling
 
     // SVM specific parameters
     'c': [0.01, 0.125, 0.5, 1, 2],         // cost for C_SVC, EPSILON_SVR and NU_SVR
@@ -28,9 +33,15 @@ module.exports = {
     'retained-variance': 0.99,                // Define the acceptable impact on data integrity (if PCA activated)
 
     'eps': 1e-3,                              // stopping criteria
-    'cache-size': 200,                        // cache size in MB
+    'cache-size': 200,                        // cache size in MB, or 'auto' (from the free memory)
     'shrinking' : true,                       // whether to use the shrinking heuristics
     'probability' : false,                    // whether to train a SVC or SVR model for probability estimates
+    'fast-kernel-math' : false,               // whether to use approximate exp/tanh for RBF and SIGMOID kernels
+    'threads' : 1,                            // number of threads computing kernel columns during training
+    'half-precision-cache' : false,           // whether to cache kernel columns as bfloat16 (twice as many columns)
+    'cache-policy' : cachePolicies.LRU,       // kernel columns evicted first (LRU or SHRINKING)
+    'share-kernel' : true,                    // whether one-vs-one subproblems share kernel values (more than 2 classes)
+    'kernel-store-size' : 0,                  // MB of kernel columns shared by the trainings of the search (0 to disable)
 
     // cli
     'color': true,
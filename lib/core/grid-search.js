@@ -10,11 +10,11 @@ var numeric= require('numeric');
 var svmTypes = require('./svm-types');
 var kernelTypes = require('./kernel-types');
 var BaseSVM = require('./base-svm');
+var Dataset = require('./dataset');
 var defaultConfig = require('./config');
 
 var evaluators = require('../evaluators');
 
-var splitDataset = require('../util/split-dataset');
 var createError = require('../util/create-error');
 var crossCombinations = require('../util/cross-combinations');
 
@@ -38,12 +38,15 @@ module.exports = function(dataset, config){
         params.r || []
     ]);
 
-    // split dataset for cross-validation
-    var subsets = splitDataset(dataset, params.kFold);
-
     var evaluator = evaluators.getDefault(params);
 
-    var total = combs.length * subsets.length,
+    // convert rows once, then split them for cross-validation:
+    // folds are index views, rows are never copied
+    var rows = new Dataset(dataset);
+    var stratified = params.svmType === svmTypes.C_SVC || params.svmType === svmTypes.NU_SVC;
+    var folds = rows.splitFolds(params.kFold, stratified);
+
+    var total = combs.length * folds.length,
         done = 0;
 
     // perform k-fold cross-validation for
@@ -57,15 +60,15 @@ module.exports = function(dataset, config){
             degree: comb[4],
             r: comb[5]
         });
-        var cPromises = subsets.map(function(ss){
+        var cPromises = folds.map(function(fold){
             var clf = new BaseSVM();
 
             return clf
-                .train(ss.train, cParams) // train with train set
+                .train(rows.subset(fold.train), cParams) // train with train set
                 .then(function(){         // predict values for each example of the test set
                     done += 1;
                     deferred.notify({ done: done, total: total });
-                    return _a.map(ss.test, function(test){ return [clf.predictSync(test[0]), test[1]]; });
+                    return _a.map(fold.test, function(i){ return [clf.predictSync(dataset[i][0]), dataset[i][1]]; });
                 });
         });
 
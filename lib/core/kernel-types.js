@@ -4,5 +4,6 @@ module.exports = {
     LINEAR : 0,
     POLY : 1,
     RBF  : 2,
-    SIGMOID : 3
+    SIGMOID : 3,
+    PRECOMPUTED : 4 // see `BaseSVM.trainPrecomputed`
 };
\ No newline at end of file
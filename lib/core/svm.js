@@ -143,6 +143,12 @@ SVM.prototype.isTraining = function() {
     return this._training;
 };
 
+// kernel cache statistics of the final training (see BaseSVM#getTrainingStats)
+SVM.prototype.getTrainingStats = function() {
+    assert(this.isTrained(), 'train classifier first');
+    return this._baseSvm.getTrainingStats();
+};
+
 SVM.prototype.predict = function(x){
     assert(this.isTrained());
     return this._baseSvm.predict(this._format(x));
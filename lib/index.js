@@ -3,9 +3,12 @@
 var util = require('util');
 var svmTypes = require('./core/svm-types');
 var kernelTypes = require('./core/kernel-types');
+var approximationTypes = require('./core/approximation-types');
+var cachePolicies = require('./core/cache-policies');
 var defaultConfig = require('./core/config');
 
 var SVM = require('./core/svm');
+var Dataset = require('./core/dataset');
 var readDataset = require('./util/read-dataset');
 
 function CSVC(config, model) {
@@ -51,10 +54,13 @@ function restore(model) {
 module.exports = {
     svmTypes: svmTypes,
     kernelTypes: kernelTypes,
+    approximationTypes: approximationTypes,
+    cachePolicies: cachePolicies,
 
     // utils
     read: readDataset,
     restore: restore,
+    Dataset: Dataset,
 
     SVM: SVM,
     CSVC: CSVC,
@@ -1,10 +1,12 @@
 #ifndef _LIBSVM_ADDON_H
 #define _LIBSVM_ADDON_H
 #include "node-svm/node-svm.h"
+#include "node-svm/dataset.h"
 
 extern "C" {
   void InitAll(Local<Object> exports) {
     NodeSvm::Init(exports);
+    Dataset::Init(exports);
   }
 }
 
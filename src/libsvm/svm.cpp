@@ -6,7 +6,13 @@
 #include <string.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <stdint.h>
 #include <locale.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
 #include "svm.h"
 int libsvm_version = LIBSVM_VERSION;
 typedef float Qfloat;
@@ -38,6 +44,522 @@ static inline double powi(double base, int times)
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
 
+// cache line aligned allocations
+#define ALIGNMENT 64
+static void *aligned_malloc(size_t size)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, ALIGNMENT);
+#else
+	void *ptr;
+	return posix_memalign(&ptr, ALIGNMENT, size) == 0 ? ptr : NULL;
+#endif
+}
+static void aligned_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+//
+// Vector kernels
+//
+// Dot products and squared distances of dense rows (see Kernel::init_dense),
+// accumulated in double, and exp/tanh over a whole kernel column (see
+// Kernel::kernel_column). The AVX2 and AVX-512 versions are compiled through
+// target attributes, so that the default build stays portable, and are
+// selected once at load time from the CPU features, with a scalar fallback.
+// Define SVM_NO_SIMD to build the scalar versions only.
+//
+// Vectorized exp/tanh are within a couple of ulp of libm (Cephes exp).
+// Results that overflow a double are only guaranteed to be +inf and
+// subnormal results of exp are flushed to 0: kernel columns are stored
+// as Qfloat anyway.
+//
+// With svm_parameter.fast_math, exp and tanh are replaced by cheaper
+// approximations, good to about Qfloat precision (see exp_fast/tanh_fast).
+//
+#if !defined(SVM_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SVM_X86_SIMD
+#include <immintrin.h>
+#endif
+
+typedef double (*dense_kernel)(const svm_node_value *px, const svm_node_value *py, int n);
+typedef void (*column_function)(double *v, int n); // v[k] = f(v[k])
+
+static double dense_dot_scalar(const svm_node_value *px, const svm_node_value *py, int n)
+{
+	double sum = 0;
+	for(int k=0;k<n;k++)
+		sum += (double)px[k] * py[k];
+	return sum;
+}
+
+static double dense_dist2_scalar(const svm_node_value *px, const svm_node_value *py, int n)
+{
+	double sum = 0;
+	for(int k=0;k<n;k++)
+	{
+		double d = (double)px[k] - py[k];
+		sum += d*d;
+	}
+	return sum;
+}
+
+static void exp_column_scalar(double *v, int n)
+{
+	for(int k=0;k<n;k++)
+		v[k] = exp(v[k]);
+}
+
+static void tanh_column_scalar(double *v, int n)
+{
+	for(int k=0;k<n;k++)
+		v[k] = tanh(v[k]);
+}
+
+// exp(x) = 2^n P(r), |r| <= ln(2)/2, P degree 7 Taylor polynomial: no division.
+// Max relative error 1e-8. Inputs are clamped to [FAST_EXP_MIN, FAST_EXP_MAX]
+#define FAST_EXP_MIN -708.0
+#define FAST_EXP_MAX 709.0
+#define FAST_EXP_LOG2E 1.4426950408889634073599
+#define FAST_EXP_LN2 0.693147180559945309417232121458
+#define FAST_EXP_P7 (1.0/5040)
+#define FAST_EXP_P6 (1.0/720)
+#define FAST_EXP_P5 (1.0/120)
+#define FAST_EXP_P4 (1.0/24)
+#define FAST_EXP_P3 (1.0/6)
+#define FAST_EXP_P2 0.5
+// tanh(x) = x P(x^2)/Q(x^2) for |x| <= FAST_TANH_MAX (from Eigen's float tanh),
+// +-tanh(FAST_TANH_MAX) beyond. Max relative error 3e-7
+#define FAST_TANH_MAX 7.90531110763549805
+#define FAST_TANH_A13 -2.76076847742355e-16
+#define FAST_TANH_A11 2.00018790482477e-13
+#define FAST_TANH_A9 -8.60467152213735e-11
+#define FAST_TANH_A7 5.12229709037114e-08
+#define FAST_TANH_A5 1.48572235717979e-05
+#define FAST_TANH_A3 6.37261928875436e-04
+#define FAST_TANH_A1 4.89352455891786e-03
+#define FAST_TANH_B6 1.19825839466702e-06
+#define FAST_TANH_B4 1.18534705686654e-04
+#define FAST_TANH_B2 2.26843463243900e-03
+#define FAST_TANH_B0 4.89352518554385e-03
+
+static inline double exp_fast(double x)
+{
+	x = min(max(x,FAST_EXP_MIN),FAST_EXP_MAX);
+	int n = (int)(x*FAST_EXP_LOG2E + (x < 0 ? -0.5 : 0.5));
+	double r = x - n*FAST_EXP_LN2;
+	double p = (((((FAST_EXP_P7*r+FAST_EXP_P6)*r+FAST_EXP_P5)*r+FAST_EXP_P4)*r+FAST_EXP_P3)*r+FAST_EXP_P2)*r;
+	// 2^n from its bits
+	uint64_t bits = (uint64_t)(n + 1023) << 52;
+	double scale;
+	memcpy(&scale,&bits,sizeof(scale));
+	return ((p*r+r)+1.0)*scale;
+}
+
+static inline double tanh_fast(double x)
+{
+	x = min(max(x,-FAST_TANH_MAX),FAST_TANH_MAX);
+	double z = x*x;
+	double p = (((((FAST_TANH_A13*z+FAST_TANH_A11)*z+FAST_TANH_A9)*z+FAST_TANH_A7)*z+FAST_TANH_A5)*z+FAST_TANH_A3)*z+FAST_TANH_A1;
+	double q = ((FAST_TANH_B6*z+FAST_TANH_B4)*z+FAST_TANH_B2)*z+FAST_TANH_B0;
+	return x*p/q;
+}
+
+static void exp_fast_column_scalar(double *v, int n)
+{
+	for(int k=0;k<n;k++)
+		v[k] = exp_fast(v[k]);
+}
+
+static void tanh_fast_column_scalar(double *v, int n)
+{
+	for(int k=0;k<n;k++)
+		v[k] = tanh_fast(v[k]);
+}
+
+#ifdef SVM_X86_SIMD
+// exp(x) = 2^n exp(r), |r| <= ln(2)/2, exp(r) = 1 + 2r P(r^2)/(Q(r^2) - r P(r^2))
+#define EXP_MIN -708.39641853226408
+#define EXP_MAX 709.78271289338397
+#define EXP_LOG2E 1.4426950408889634073599
+#define EXP_C1 6.93145751953125E-1
+#define EXP_C2 1.42860682030941723212E-6
+#define EXP_P0 1.26177193074810590878E-4
+#define EXP_P1 3.02994407707441961300E-2
+#define EXP_P2 9.99999999999999999910E-1
+#define EXP_Q0 3.00198505138664455042E-6
+#define EXP_Q1 2.52448340349684104192E-3
+#define EXP_Q2 2.27265548208155028766E-1
+#define EXP_Q3 2.00000000000000000009E0
+// adding it to an integral double leaves that integer (+ the bias) in the low bits
+#define EXP_SHIFTER (6755399441055744.0 + 1023.0)
+// tanh(x) = x + x z P(z)/Q(z), z = x^2, for |x| < TANH_SMALL (1 - exp(-2|x|) loses precision)
+#define TANH_SMALL 0.625
+#define TANH_P0 -9.64399179425052238628E-1
+#define TANH_P1 -9.92877231001918586564E1
+#define TANH_P2 -1.61468768441708447952E3
+#define TANH_Q0 1.12811678491632931402E2
+#define TANH_Q1 2.23548839060100448583E3
+#define TANH_Q2 4.84406305325125486048E3
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+AVX2_TARGET static inline __m256d load4_avx2(const double *p) { return _mm256_loadu_pd(p); }
+AVX2_TARGET static inline __m256d load4_avx2(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+
+AVX2_TARGET static inline double sum_avx2(__m256d v)
+{
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v),_mm256_extractf128_pd(v,1));
+	return _mm_cvtsd_f64(_mm_add_sd(s,_mm_unpackhi_pd(s,s)));
+}
+
+AVX2_TARGET static double dense_dot_avx2(const svm_node_value *px, const svm_node_value *py, int n)
+{
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	int k = 0;
+	for(;k+8<=n;k+=8)
+	{
+		sum0 = _mm256_fmadd_pd(load4_avx2(px+k),load4_avx2(py+k),sum0);
+		sum1 = _mm256_fmadd_pd(load4_avx2(px+k+4),load4_avx2(py+k+4),sum1);
+	}
+	for(;k+4<=n;k+=4)
+		sum0 = _mm256_fmadd_pd(load4_avx2(px+k),load4_avx2(py+k),sum0);
+	double sum = sum_avx2(_mm256_add_pd(sum0,sum1));
+	for(;k<n;k++)
+		sum += (double)px[k] * py[k];
+	return sum;
+}
+
+AVX2_TARGET static double dense_dist2_avx2(const svm_node_value *px, const svm_node_value *py, int n)
+{
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	int k = 0;
+	for(;k+8<=n;k+=8)
+	{
+		__m256d d0 = _mm256_sub_pd(load4_avx2(px+k),load4_avx2(py+k));
+		__m256d d1 = _mm256_sub_pd(load4_avx2(px+k+4),load4_avx2(py+k+4));
+		sum0 = _mm256_fmadd_pd(d0,d0,sum0);
+		sum1 = _mm256_fmadd_pd(d1,d1,sum1);
+	}
+	for(;k+4<=n;k+=4)
+	{
+		__m256d d = _mm256_sub_pd(load4_avx2(px+k),load4_avx2(py+k));
+		sum0 = _mm256_fmadd_pd(d,d,sum0);
+	}
+	double sum = sum_avx2(_mm256_add_pd(sum0,sum1));
+	for(;k<n;k++)
+	{
+		double d = (double)px[k] - py[k];
+		sum += d*d;
+	}
+	return sum;
+}
+
+AVX2_TARGET static inline __m256d exp_avx2(__m256d x)
+{
+	__m256d underflow = _mm256_cmp_pd(x,_mm256_set1_pd(EXP_MIN),_CMP_LT_OQ);
+	x = _mm256_min_pd(_mm256_max_pd(x,_mm256_set1_pd(EXP_MIN)),_mm256_set1_pd(EXP_MAX));
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x,_mm256_set1_pd(EXP_LOG2E)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+	x = _mm256_fnmadd_pd(n,_mm256_set1_pd(EXP_C1),x);
+	x = _mm256_fnmadd_pd(n,_mm256_set1_pd(EXP_C2),x);
+	__m256d xx = _mm256_mul_pd(x,x);
+	__m256d px = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(EXP_P0),xx,_mm256_set1_pd(EXP_P1)),xx,_mm256_set1_pd(EXP_P2));
+	px = _mm256_mul_pd(px,x);
+	__m256d qx = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(EXP_Q0),xx,_mm256_set1_pd(EXP_Q1)),xx,_mm256_set1_pd(EXP_Q2)),xx,_mm256_set1_pd(EXP_Q3));
+	x = _mm256_div_pd(px,_mm256_sub_pd(qx,px));
+	x = _mm256_fmadd_pd(_mm256_set1_pd(2.0),x,_mm256_set1_pd(1.0));
+	__m256i e = _mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n,_mm256_set1_pd(EXP_SHIFTER))),52);
+	x = _mm256_mul_pd(x,_mm256_castsi256_pd(e));
+	return _mm256_andnot_pd(underflow,x);
+}
+
+AVX2_TARGET static inline __m256d tanh_avx2(__m256d x)
+{
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	__m256d a = _mm256_andnot_pd(sign,x);
+	__m256d t = exp_avx2(_mm256_mul_pd(a,_mm256_set1_pd(-2.0)));
+	__m256d y = _mm256_div_pd(_mm256_sub_pd(one,t),_mm256_add_pd(one,t));
+	__m256d z = _mm256_mul_pd(a,a);
+	__m256d pz = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(TANH_P0),z,_mm256_set1_pd(TANH_P1)),z,_mm256_set1_pd(TANH_P2));
+	__m256d qz = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_add_pd(z,_mm256_set1_pd(TANH_Q0)),z,_mm256_set1_pd(TANH_Q1)),z,_mm256_set1_pd(TANH_Q2));
+	__m256d small = _mm256_fmadd_pd(_mm256_mul_pd(a,z),_mm256_div_pd(pz,qz),a);
+	y = _mm256_blendv_pd(y,small,_mm256_cmp_pd(a,_mm256_set1_pd(TANH_SMALL),_CMP_LT_OQ));
+	return _mm256_or_pd(y,_mm256_and_pd(sign,x));
+}
+
+AVX2_TARGET static inline __m256d exp_fast_avx2(__m256d x)
+{
+	x = _mm256_min_pd(_mm256_max_pd(x,_mm256_set1_pd(FAST_EXP_MIN)),_mm256_set1_pd(FAST_EXP_MAX));
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x,_mm256_set1_pd(FAST_EXP_LOG2E)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(n,_mm256_set1_pd(FAST_EXP_LN2),x);
+	__m256d p = _mm256_fmadd_pd(_mm256_set1_pd(FAST_EXP_P7),r,_mm256_set1_pd(FAST_EXP_P6));
+	p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(FAST_EXP_P5));
+	p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(FAST_EXP_P4));
+	p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(FAST_EXP_P3));
+	p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(FAST_EXP_P2));
+	p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0));
+	p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0));
+	__m256i e = _mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n,_mm256_set1_pd(EXP_SHIFTER))),52);
+	return _mm256_mul_pd(p,_mm256_castsi256_pd(e));
+}
+
+AVX2_TARGET static inline __m256d tanh_fast_avx2(__m256d x)
+{
+	x = _mm256_min_pd(_mm256_max_pd(x,_mm256_set1_pd(-FAST_TANH_MAX)),_mm256_set1_pd(FAST_TANH_MAX));
+	__m256d z = _mm256_mul_pd(x,x);
+	__m256d p = _mm256_fmadd_pd(_mm256_set1_pd(FAST_TANH_A13),z,_mm256_set1_pd(FAST_TANH_A11));
+	p = _mm256_fmadd_pd(p,z,_mm256_set1_pd(FAST_TANH_A9));
+	p = _mm256_fmadd_pd(p,z,_mm256_set1_pd(FAST_TANH_A7));
+	p = _mm256_fmadd_pd(p,z,_mm256_set1_pd(FAST_TANH_A5));
+	p = _mm256_fmadd_pd(p,z,_mm256_set1_pd(FAST_TANH_A3));
+	p = _mm256_fmadd_pd(p,z,_mm256_set1_pd(FAST_TANH_A1));
+	__m256d q = _mm256_fmadd_pd(_mm256_set1_pd(FAST_TANH_B6),z,_mm256_set1_pd(FAST_TANH_B4));
+	q = _mm256_fmadd_pd(q,z,_mm256_set1_pd(FAST_TANH_B2));
+	q = _mm256_fmadd_pd(q,z,_mm256_set1_pd(FAST_TANH_B0));
+	return _mm256_div_pd(_mm256_mul_pd(x,p),q);
+}
+
+AVX2_TARGET static void exp_column_avx2(double *v, int n)
+{
+	int k = 0;
+	for(;k+4<=n;k+=4)
+		_mm256_storeu_pd(v+k,exp_avx2(_mm256_loadu_pd(v+k)));
+	exp_column_scalar(v+k,n-k);
+}
+
+AVX2_TARGET static void tanh_column_avx2(double *v, int n)
+{
+	int k = 0;
+	for(;k+4<=n;k+=4)
+		_mm256_storeu_pd(v+k,tanh_avx2(_mm256_loadu_pd(v+k)));
+	tanh_column_scalar(v+k,n-k);
+}
+
+AVX2_TARGET static void exp_fast_column_avx2(double *v, int n)
+{
+	int k = 0;
+	for(;k+4<=n;k+=4)
+		_mm256_storeu_pd(v+k,exp_fast_avx2(_mm256_loadu_pd(v+k)));
+	exp_fast_column_scalar(v+k,n-k);
+}
+
+AVX2_TARGET static void tanh_fast_column_avx2(double *v, int n)
+{
+	int k = 0;
+	for(;k+4<=n;k+=4)
+		_mm256_storeu_pd(v+k,tanh_fast_avx2(_mm256_loadu_pd(v+k)));
+	tanh_fast_column_scalar(v+k,n-k);
+}
+
+// GCC 12 AVX-512 intrinsics trip -Wmaybe-uninitialized (GCC bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+AVX512_TARGET static inline __m512d load8_avx512(const double *p) { return _mm512_loadu_pd(p); }
+AVX512_TARGET static inline __m512d load8_avx512(const float *p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+
+AVX512_TARGET static inline double sum_avx512(__m512d v)
+{
+	double s[8];
+	_mm512_storeu_pd(s,v);
+	return ((s[0]+s[4])+(s[1]+s[5]))+((s[2]+s[6])+(s[3]+s[7]));
+}
+
+AVX512_TARGET static double dense_dot_avx512(const svm_node_value *px, const svm_node_value *py, int n)
+{
+	__m512d sum0 = _mm512_setzero_pd();
+	__m512d sum1 = _mm512_setzero_pd();
+	int k = 0;
+	for(;k+16<=n;k+=16)
+	{
+		sum0 = _mm512_fmadd_pd(load8_avx512(px+k),load8_avx512(py+k),sum0);
+		sum1 = _mm512_fmadd_pd(load8_avx512(px+k+8),load8_avx512(py+k+8),sum1);
+	}
+	for(;k+8<=n;k+=8)
+		sum0 = _mm512_fmadd_pd(load8_avx512(px+k),load8_avx512(py+k),sum0);
+	double sum = sum_avx512(_mm512_add_pd(sum0,sum1));
+	for(;k<n;k++)
+		sum += (double)px[k] * py[k];
+	return sum;
+}
+
+AVX512_TARGET static double dense_dist2_avx512(const svm_node_value *px, const svm_node_value *py, int n)
+{
+	__m512d sum0 = _mm512_setzero_pd();
+	__m512d sum1 = _mm512_setzero_pd();
+	int k = 0;
+	for(;k+16<=n;k+=16)
+	{
+		__m512d d0 = _mm512_sub_pd(load8_avx512(px+k),load8_avx512(py+k));
+		__m512d d1 = _mm512_sub_pd(load8_avx512(px+k+8),load8_avx512(py+k+8));
+		sum0 = _mm512_fmadd_pd(d0,d0,sum0);
+		sum1 = _mm512_fmadd_pd(d1,d1,sum1);
+	}
+	for(;k+8<=n;k+=8)
+	{
+		__m512d d = _mm512_sub_pd(load8_avx512(px+k),load8_avx512(py+k));
+		sum0 = _mm512_fmadd_pd(d,d,sum0);
+	}
+	double sum = sum_avx512(_mm512_add_pd(sum0,sum1));
+	for(;k<n;k++)
+	{
+		double d = (double)px[k] - py[k];
+		sum += d*d;
+	}
+	return sum;
+}
+AVX512_TARGET static inline __m512d exp_avx512(__m512d x)
+{
+	__mmask8 underflow = _mm512_cmp_pd_mask(x,_mm512_set1_pd(EXP_MIN),_CMP_LT_OQ);
+	x = _mm512_min_pd(_mm512_max_pd(x,_mm512_set1_pd(EXP_MIN)),_mm512_set1_pd(EXP_MAX));
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x,_mm512_set1_pd(EXP_LOG2E)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+	x = _mm512_fnmadd_pd(n,_mm512_set1_pd(EXP_C1),x);
+	x = _mm512_fnmadd_pd(n,_mm512_set1_pd(EXP_C2),x);
+	__m512d xx = _mm512_mul_pd(x,x);
+	__m512d px = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(EXP_P0),xx,_mm512_set1_pd(EXP_P1)),xx,_mm512_set1_pd(EXP_P2));
+	px = _mm512_mul_pd(px,x);
+	__m512d qx = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(EXP_Q0),xx,_mm512_set1_pd(EXP_Q1)),xx,_mm512_set1_pd(EXP_Q2)),xx,_mm512_set1_pd(EXP_Q3));
+	x = _mm512_div_pd(px,_mm512_sub_pd(qx,px));
+	x = _mm512_fmadd_pd(_mm512_set1_pd(2.0),x,_mm512_set1_pd(1.0));
+	__m512i e = _mm512_slli_epi64(_mm512_castpd_si512(_mm512_add_pd(n,_mm512_set1_pd(EXP_SHIFTER))),52);
+	x = _mm512_mul_pd(x,_mm512_castsi512_pd(e));
+	return _mm512_maskz_mov_pd((__mmask8)~underflow,x);
+}
+
+AVX512_TARGET static inline __m512d tanh_avx512(__m512d x)
+{
+	const __m512i sign = _mm512_set1_epi64((long long)0x8000000000000000ULL);
+	const __m512d one = _mm512_set1_pd(1.0);
+	__m512i bits = _mm512_castpd_si512(x);
+	__m512d a = _mm512_castsi512_pd(_mm512_andnot_si512(sign,bits));
+	__m512d t = exp_avx512(_mm512_mul_pd(a,_mm512_set1_pd(-2.0)));
+	__m512d y = _mm512_div_pd(_mm512_sub_pd(one,t),_mm512_add_pd(one,t));
+	__m512d z = _mm512_mul_pd(a,a);
+	__m512d pz = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(TANH_P0),z,_mm512_set1_pd(TANH_P1)),z,_mm512_set1_pd(TANH_P2));
+	__m512d qz = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_add_pd(z,_mm512_set1_pd(TANH_Q0)),z,_mm512_set1_pd(TANH_Q1)),z,_mm512_set1_pd(TANH_Q2));
+	__m512d small = _mm512_fmadd_pd(_mm512_mul_pd(a,z),_mm512_div_pd(pz,qz),a);
+	y = _mm512_mask_mov_pd(y,_mm512_cmp_pd_mask(a,_mm512_set1_pd(TANH_SMALL),_CMP_LT_OQ),small);
+	return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(y),_mm512_and_si512(sign,bits)));
+}
+
+AVX512_TARGET static inline __m512d exp_fast_avx512(__m512d x)
+{
+	x = _mm512_min_pd(_mm512_max_pd(x,_mm512_set1_pd(FAST_EXP_MIN)),_mm512_set1_pd(FAST_EXP_MAX));
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x,_mm512_set1_pd(FAST_EXP_LOG2E)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+	__m512d r = _mm512_fnmadd_pd(n,_mm512_set1_pd(FAST_EXP_LN2),x);
+	__m512d p = _mm512_fmadd_pd(_mm512_set1_pd(FAST_EXP_P7),r,_mm512_set1_pd(FAST_EXP_P6));
+	p = _mm512_fmadd_pd(p,r,_mm512_set1_pd(FAST_EXP_P5));
+	p = _mm512_fmadd_pd(p,r,_mm512_set1_pd(FAST_EXP_P4));
+	p = _mm512_fmadd_pd(p,r,_mm512_set1_pd(FAST_EXP_P3));
+	p = _mm512_fmadd_pd(p,r,_mm512_set1_pd(FAST_EXP_P2));
+	p = _mm512_fmadd_pd(p,r,_mm512_set1_pd(1.0));
+	p = _mm512_fmadd_pd(p,r,_mm512_set1_pd(1.0));
+	__m512i e = _mm512_slli_epi64(_mm512_castpd_si512(_mm512_add_pd(n,_mm512_set1_pd(EXP_SHIFTER))),52);
+	return _mm512_mul_pd(p,_mm512_castsi512_pd(e));
+}
+
+AVX512_TARGET static inline __m512d tanh_fast_avx512(__m512d x)
+{
+	x = _mm512_min_pd(_mm512_max_pd(x,_mm512_set1_pd(-FAST_TANH_MAX)),_mm512_set1_pd(FAST_TANH_MAX));
+	__m512d z = _mm512_mul_pd(x,x);
+	__m512d p = _mm512_fmadd_pd(_mm512_set1_pd(FAST_TANH_A13),z,_mm512_set1_pd(FAST_TANH_A11));
+	p = _mm512_fmadd_pd(p,z,_mm512_set1_pd(FAST_TANH_A9));
+	p = _mm512_fmadd_pd(p,z,_mm512_set1_pd(FAST_TANH_A7));
+	p = _mm512_fmadd_pd(p,z,_mm512_set1_pd(FAST_TANH_A5));
+	p = _mm512_fmadd_pd(p,z,_mm512_set1_pd(FAST_TANH_A3));
+	p = _mm512_fmadd_pd(p,z,_mm512_set1_pd(FAST_TANH_A1));
+	__m512d q = _mm512_fmadd_pd(_mm512_set1_pd(FAST_TANH_B6),z,_mm512_set1_pd(FAST_TANH_B4));
+	q = _mm512_fmadd_pd(q,z,_mm512_set1_pd(FAST_TANH_B2));
+	q = _mm512_fmadd_pd(q,z,_mm512_set1_pd(FAST_TANH_B0));
+	return _mm512_div_pd(_mm512_mul_pd(x,p),q);
+}
+
+AVX512_TARGET static void exp_column_avx512(double *v, int n)
+{
+	int k = 0;
+	for(;k+8<=n;k+=8)
+		_mm512_storeu_pd(v+k,exp_avx512(_mm512_loadu_pd(v+k)));
+	exp_column_scalar(v+k,n-k);
+}
+
+AVX512_TARGET static void tanh_column_avx512(double *v, int n)
+{
+	int k = 0;
+	for(;k+8<=n;k+=8)
+		_mm512_storeu_pd(v+k,tanh_avx512(_mm512_loadu_pd(v+k)));
+	tanh_column_scalar(v+k,n-k);
+}
+
+AVX512_TARGET static void exp_fast_column_avx512(double *v, int n)
+{
+	int k = 0;
+	for(;k+8<=n;k+=8)
+		_mm512_storeu_pd(v+k,exp_fast_avx512(_mm512_loadu_pd(v+k)));
+	exp_fast_column_scalar(v+k,n-k);
+}
+
+AVX512_TARGET static void tanh_fast_column_avx512(double *v, int n)
+{
+	int k = 0;
+	for(;k+8<=n;k+=8)
+		_mm512_storeu_pd(v+k,tanh_fast_avx512(_mm512_loadu_pd(v+k)));
+	tanh_fast_column_scalar(v+k,n-k);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+struct vector_kernels {
+	dense_kernel dot;
+	dense_kernel dist2;
+	column_function exp;
+	column_function tanh;
+	column_function exp_fast;
+	column_function tanh_fast;
+};
+
+static vector_kernels select_vector_kernels()
+{
+	vector_kernels kernels = { &dense_dot_scalar, &dense_dist2_scalar, &exp_column_scalar, &tanh_column_scalar,
+				   &exp_fast_column_scalar, &tanh_fast_column_scalar };
+#ifdef SVM_X86_SIMD
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+	{
+		kernels.dot = &dense_dot_avx512;
+		kernels.dist2 = &dense_dist2_avx512;
+		kernels.exp = &exp_column_avx512;
+		kernels.tanh = &tanh_column_avx512;
+		kernels.exp_fast = &exp_fast_column_avx512;
+		kernels.tanh_fast = &tanh_fast_column_avx512;
+	}
+	else if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	{
+		kernels.dot = &dense_dot_avx2;
+		kernels.dist2 = &dense_dist2_avx2;
+		kernels.exp = &exp_column_avx2;
+		kernels.tanh = &tanh_column_avx2;
+		kernels.exp_fast = &exp_fast_column_avx2;
+		kernels.tanh_fast = &tanh_fast_column_avx2;
+	}
+#endif
+	return kernels;
+}
+
+static const vector_kernels simd_kernels = select_vector_kernels();
+
 static void print_string_stdout(const char *s)
 {
 	fputs(s,stdout);
@@ -63,217 +585,747 @@ static void info(const char *fmt,...) {}
 //
 // l is the number of total data items
 // size is the cache size limit in bytes
+// T is the type columns are stored as (Qfloat, or Qhalf, see ColumnCache)
+//
+// Columns live in fixed-stride slots of one slab allocated up front: a
+// column never moves when it grows, and evictions hand its slot over
+// (free slots are chained through their own memory), so get_data never
+// calls the allocator. The slab holds size / (l * sizeof(T)) columns, at
+// least two and at most l.
 //
-class Cache
+// swap_index is O(1): it swaps the two heads and logs the swap. Columns
+// replay the swaps logged since their last use when they are requested
+// again (see sync), so the solver swapping variables does not walk the
+// cache. A column that crosses a swap (i < len <= j) keeps its [0,i) part,
+// one not used during the last l swaps is dropped.
+//
+// Evictions follow the least recently used column, unless priorities are
+// used (SHRINKING_CACHE policy): then the least recently used column of the
+// lowest priority goes first, columns being ranked by set_priority. The
+// column returned last is never evicted, as the solver uses Q_i and Q_j
+// together.
+//
+enum { INACTIVE_COLUMN, BOUND_COLUMN, FREE_COLUMN, NR_PRIORITIES };	/* column priorities */
+
+template<class T> class Cache
 {
 public:
-	Cache(int l,long int size);
+	Cache(int l,long int size,int policy);
 	~Cache();
 
 	// request data [0,len)
 	// return some position p where [p,len) need to be filled
 	// (p >= len if nothing needs to be filled)
-	int get_data(const int index, Qfloat **data, int len);
+	int get_data(const int index, T **data, int len);
 	void swap_index(int i, int j);
+	void set_priority(int index, int priority);
+	static long int full_size(int l);	// bytes of a cache holding all the columns
+
+	// statistics
+	long long evictions;	// columns evicted to make room for others
+	long long recomputed;	// columns computed again after being evicted or dropped
+	long int bytes;		// slab and heads
 private:
 	int l;
-	long int size;
+	static long int column_stride(int l)	// room for the free list link
+	{
+		return max((long int)l,(long int)((sizeof(T *)+sizeof(T)-1)/sizeof(T)));
+	}
 	struct head_t
 	{
 		head_t *prev, *next;	// a circular list
-		Qfloat *data;
+		T *data;		// slot, NULL if not cached (then len is 0)
 		int len;		// data[0,len) is cached in this entry
+		bool computed;		// data was filled before
+		char priority;		// eviction priority of the column
+		long long synced;	// number of swaps applied to data
 	};
 
 	head_t *head;
-	head_t lru_head;
+	head_t lru_head[NR_PRIORITIES];	// one list per priority
+	bool use_priorities;
+	head_t *last;		// column returned last
 	void lru_delete(head_t *h);
 	void lru_insert(head_t *h);
+
+	T *slab;		// nr_slots slots of stride elements
+	long int stride;
+	T *free_slot;		// first free slot, each one starting with the next one
+	T *new_slot();
+	void release_slot(T *slot);
+
+	int *swap_log;		// ring of the last l swaps, (i,j) pairs
+	long long nr_swaps;
+	void sync(head_t *h);
 };
 
-Cache::Cache(int l_,long int size_):l(l_),size(size_)
+template<class T> Cache<T>::Cache(int l_,long int size,int policy):l(l_)
 {
 	head = (head_t *)calloc(l,sizeof(head_t));	// initialized to 0
-	size /= sizeof(Qfloat);
-	size -= l * sizeof(head_t) / sizeof(Qfloat);
-	size = max(size, 2 * (long int) l);	// cache must be large enough for two columns
-	lru_head.next = lru_head.prev = &lru_head;
+	for(int p=0;p<NR_PRIORITIES;p++)
+		lru_head[p].next = lru_head[p].prev = &lru_head[p];
+	use_priorities = policy == SHRINKING_CACHE;
+	last = NULL;
+
+	stride = column_stride(l);
+	size /= sizeof(T);
+	size -= l * sizeof(head_t) / sizeof(T);
+	long int nr_slots = min(max(size/stride,2L),(long int)l);	// cache must be large enough for two columns
+	slab = (T *)malloc(sizeof(T)*stride*nr_slots);
+	bytes = sizeof(T)*stride*nr_slots + l*sizeof(head_t);
+	evictions = recomputed = 0;
+	free_slot = NULL;
+	for(long int k=nr_slots-1;k>=0;k--)
+		release_slot(slab+k*stride);
+
+	swap_log = Malloc(int,2*l);
+	nr_swaps = 0;
 }
 
-Cache::~Cache()
+template<class T> long int Cache<T>::full_size(int l)
 {
-	for(head_t *h = lru_head.next; h != &lru_head; h=h->next)
-		free(h->data);
+	return sizeof(T)*column_stride(l)*l + l*sizeof(head_t);
+}
+
+template<class T> Cache<T>::~Cache()
+{
+	free(slab);
 	free(head);
+	free(swap_log);
+}
+
+template<class T> T *Cache<T>::new_slot()
+{
+	T *slot = free_slot;
+	if(slot)
+	{
+		memcpy(&free_slot,slot,sizeof(T *));
+		return slot;
+	}
+	// evict the least recently used column (of the lowest priority)
+	head_t *old = NULL;
+	for(int p=0;old == NULL;p++)
+	{
+		old = lru_head[p].next;
+		if(old == last)
+			old = old->next;
+		if(old == &lru_head[p])
+			old = NULL;	// no other column of priority p
+	}
+	lru_delete(old);
+	evictions++;
+	slot = old->data;
+	old->data = 0;
+	old->len = 0;
+	return slot;
+}
+
+template<class T> void Cache<T>::release_slot(T *slot)
+{
+	memcpy(slot,&free_slot,sizeof(T *));
+	free_slot = slot;
 }
 
-void Cache::lru_delete(head_t *h)
+template<class T> void Cache<T>::lru_delete(head_t *h)
 {
 	// delete from current location
 	h->prev->next = h->next;
 	h->next->prev = h->prev;
 }
 
-void Cache::lru_insert(head_t *h)
+template<class T> void Cache<T>::lru_insert(head_t *h)
 {
 	// insert to last position
-	h->next = &lru_head;
-	h->prev = lru_head.prev;
+	h->next = &lru_head[(int)h->priority];
+	h->prev = h->next->prev;
 	h->prev->next = h;
 	h->next->prev = h;
 }
 
-int Cache::get_data(const int index, Qfloat **data, int len)
+template<class T> void Cache<T>::sync(head_t *h)
 {
-	head_t *h = &head[index];
-	if(h->len) lru_delete(h);
-	int more = len - h->len;
+	if(nr_swaps - h->synced > l)
+		h->len = 0;	// swaps not logged anymore
+	for(long long k=h->synced; k<nr_swaps && h->len; k++)
+	{
+		int i = swap_log[2*(k%l)];
+		int j = swap_log[2*(k%l)+1];
+		if(h->len > j)
+			swap(h->data[i],h->data[j]);
+		else if(h->len > i)
+			h->len = i;
+	}
+	h->synced = nr_swaps;
+}
 
-	if(more > 0)
+template<class T> int Cache<T>::get_data(const int index, T **data, int len)
+{
+	head_t *h = &head[index];
+	if(h->data)
 	{
-		// free old space
-		while(size < more)
-		{
-			head_t *old = lru_head.next;
-			lru_delete(old);
-			free(old->data);
-			size += old->len;
-			old->data = 0;
-			old->len = 0;
-		}
+		lru_delete(h);
+		sync(h);
+	}
+	else
+		h->synced = nr_swaps;
 
-		// allocate new space
-		h->data = (Qfloat *)realloc(h->data,sizeof(Qfloat)*len);
-		size -= more;
+	if(len > h->len)
+	{
+		// slots are l long: only a new column needs one
+		if(h->data == NULL)
+			h->data = new_slot();
+		if(h->len == 0 && h->computed)
+			recomputed++;
+		h->computed = true;
 		swap(h->len,len);
 	}
 
 	lru_insert(h);
+	last = h;
 	*data = h->data;
 	return len;
 }
 
-void Cache::swap_index(int i, int j)
+template<class T> void Cache<T>::swap_index(int i, int j)
 {
 	if(i==j) return;
 
-	if(head[i].len) lru_delete(&head[i]);
-	if(head[j].len) lru_delete(&head[j]);
+	if(head[i].data) lru_delete(&head[i]);
+	if(head[j].data) lru_delete(&head[j]);
 	swap(head[i].data,head[j].data);
 	swap(head[i].len,head[j].len);
-	if(head[i].len) lru_insert(&head[i]);
-	if(head[j].len) lru_insert(&head[j]);
-
+	swap(head[i].synced,head[j].synced);
+	swap(head[i].computed,head[j].computed);
+	swap(head[i].priority,head[j].priority);
+	if(head[i].data) lru_insert(&head[i]);
+	if(head[j].data) lru_insert(&head[j]);
+	if(last == &head[i]) last = &head[j];
+	else if(last == &head[j]) last = &head[i];
+
+	// cached columns swap their elements i and j when used next (see sync)
 	if(i>j) swap(i,j);
-	for(head_t *h = lru_head.next; h!=&lru_head; h=h->next)
+	swap_log[2*(nr_swaps%l)] = i;
+	swap_log[2*(nr_swaps%l)+1] = j;
+	nr_swaps++;
+}
+
+template<class T> void Cache<T>::set_priority(int index, int priority)
+{
+	head_t *h = &head[index];
+	if(!use_priorities || h->priority == priority) return;
+	if(h->data) lru_delete(h);
+	h->priority = (char)priority;
+	if(h->data) lru_insert(h);
+}
+
+// bfloat16: the upper half of a float (same range, 8 significant bits)
+typedef uint16_t Qhalf;
+
+static inline Qhalf to_half(Qfloat v)
+{
+	uint32_t u;
+	memcpy(&u,&v,sizeof(u));
+	u += 0x7fff + ((u >> 16) & 1);	// round to nearest even
+	return (Qhalf)(u >> 16);
+}
+
+static inline Qfloat from_half(Qhalf h)
+{
+	uint32_t u = (uint32_t)h << 16;
+	Qfloat v;
+	memcpy(&v,&u,sizeof(v));
+	return v;
+}
+
+//
+// Kernel columns of a Q matrix
+//
+// get(i,len,fill) returns column i over [0,len), calling fill(start,len,data)
+// to compute the part of it that is not cached yet.
+//
+// With svm_parameter.half_cache, columns are cached as bfloat16, so that the
+// same cache size holds twice as many of them. They are widened into one of
+// two buffers on read (the last two columns returned stay valid, as the
+// solver uses Q_i and Q_j together). Computed values are rounded before
+// being returned, so a column reads the same whether it was cached or not.
+//
+// Its statistics are added to svm_parameter.stats (if any) when the
+// cache is destroyed, its size counting with the shared_bytes of kernel
+// values cached alongside it. Eviction follows svm_parameter.cache_policy.
+//
+class ColumnCache
+{
+public:
+	ColumnCache(int l, const svm_parameter& param, long long shared_bytes_ = 0)
+	:cache(NULL), half_cache(NULL), next_buffer(0), hits(0), misses(0), max_error(0), shared_bytes(shared_bytes_), stats(param.stats)
+	{
+		long int size = (long int)(param.cache_size*(1<<20));
+		if(param.half_cache)
+		{
+			half_cache = new Cache<Qhalf>(l,size,param.cache_policy);
+			buffer[0] = new Qfloat[l];
+			buffer[1] = new Qfloat[l];
+		}
+		else
+		{
+			cache = new Cache<Qfloat>(l,size,param.cache_policy);
+			buffer[0] = buffer[1] = NULL;
+		}
+	}
+
+	~ColumnCache()
+	{
+		if(stats)
+		{
+			stats->cache_hits += hits;
+			stats->cache_misses += misses;
+			stats->max_cache_error = max(stats->max_cache_error,max_error);
+			if(cache)
+				add_stats(cache);
+			else
+				add_stats(half_cache);
+		}
+		delete cache;
+		delete half_cache;
+		delete[] buffer[0];
+		delete[] buffer[1];
+	}
+
+	template<class F> Qfloat *get(int i, int len, const F& fill)
 	{
-		if(h->len > i)
+		if(cache)
 		{
-			if(h->len > j)
-				swap(h->data[i],h->data[j]);
+			Qfloat *data;
+			int start = cache->get_data(i,&data,len);
+			if(start < len)
+			{
+				misses++;
+				fill(start,len,data);
+			}
 			else
+				hits++;
+			return data;
+		}
+
+		Qhalf *half;
+		int start = half_cache->get_data(i,&half,len);
+		Qfloat *data = buffer[next_buffer];
+		next_buffer = 1 - next_buffer;
+		if(start < len)
+		{
+			misses++;
+			fill(start,len,data);
+			for(int j=start;j<len;j++)
 			{
-				// give up
-				lru_delete(h);
-				free(h->data);
-				size += h->len;
-				h->data = 0;
-				h->len = 0;
+				half[j] = to_half(data[j]);
+				Qfloat rounded = from_half(half[j]);
+				max_error = max(max_error,(double)fabs(rounded-data[j]));
+				data[j] = rounded;
 			}
 		}
+		else
+		{
+			hits++;
+			start = len;
+		}
+		for(int j=0;j<start;j++)
+			data[j] = from_half(half[j]);
+		return data;
 	}
-}
+
+	void swap_index(int i, int j)
+	{
+		if(cache)
+			cache->swap_index(i,j);
+		else
+			half_cache->swap_index(i,j);
+	}
+
+	void set_priority(int i, int priority)
+	{
+		if(cache)
+			cache->set_priority(i,priority);
+		else
+			half_cache->set_priority(i,priority);
+	}
+
+private:
+	Cache<Qfloat> *cache;
+	Cache<Qhalf> *half_cache;
+	Qfloat *buffer[2];
+	int next_buffer;
+	long long hits;
+	long long misses;
+	double max_error;
+	long long shared_bytes;
+	svm_training_stats *stats;
+
+	template<class T> void add_stats(const Cache<T> *c)
+	{
+		stats->cache_evictions += c->evictions;
+		stats->cache_recomputed += c->recomputed;
+		stats->cache_bytes = max(stats->cache_bytes,(long long)c->bytes+shared_bytes);
+	}
+};
 
 //
-// Kernel evaluation
+// Thread pool for kernel evaluations (see svm_parameter.threads)
 //
-// the static method k_function is for doing single kernel evaluation
-// the constructor of Kernel prepares to calculate the l*l kernel matrix
-// the member function get_Q is for getting one column from the Q Matrix
+// parallel_for(start,end,f) calls f(begin,end) on size() static slices of
+// [start,end), one per thread, the calling thread taking the first one, and
+// returns once every slice is done. Workers live as long as the pool and
+// sleep between calls. Ranges shorter than min_slice elements per thread
+// are split among fewer threads (or run inline).
 //
-class QMatrix {
+class ThreadPool
+{
 public:
-	virtual Qfloat *get_Q(int column, int len) const = 0;
-	virtual double *get_QD() const = 0;
-	virtual void swap_index(int i, int j) const = 0;
-	virtual ~QMatrix() {}
-};
+	ThreadPool(int nb_threads);
+	~ThreadPool();
+	int size() const { return (int)workers.size()+1; }
 
-class Kernel: public QMatrix {
-public:
+	template<class F> void parallel_for(int start, int end, const F& f)
+	{
+		int nb_slices = min(size(),(end-start)/min_slice);
+		if(nb_slices <= 1)
+			f(start,end);
+		else
+			run(start,end,nb_slices,&call<F>,&f);
+	}
+private:
+	typedef void (*task_function)(const void *f, int begin, int end);
+	template<class F> static void call(const void *f, int begin, int end)
+	{
+		(*(const F *)f)(begin,end);
+	}
+	void run(int start, int end, int nb_slices, task_function function, const void *f);
+	void slice(int k, int *begin, int *end) const;
+	void work(int k);
+
+	static const int min_slice = 4096;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;	// a task is posted (or the pool stops)
+	std::condition_variable done;	// the last worker slice of the task is done
+	unsigned long generation;	// number of tasks posted
+	int pending;	// worker slices of the current task not done yet
+	bool stopping;
+
+	// current task
+	task_function task;
+	const void *task_f;
+	int task_start, task_end, task_slices;
+};
+
+ThreadPool::ThreadPool(int nb_threads)
+:generation(0), pending(0), stopping(false), task(NULL), task_f(NULL),
+ task_start(0), task_end(0), task_slices(0)
+{
+	for(int k=1;k<nb_threads;k++)
+	{
+		try
+		{
+			workers.push_back(std::thread(&ThreadPool::work,this,k));
+		}
+		catch(...)
+		{
+			break;	// run with the threads we got
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(size_t k=0;k<workers.size();k++)
+		workers[k].join();
+}
+
+void ThreadPool::slice(int k, int *begin, int *end) const
+{
+	long long n = task_end-task_start;
+	*begin = task_start+(int)(n*k/task_slices);
+	*end = task_start+(int)(n*(k+1)/task_slices);
+}
+
+void ThreadPool::run(int start, int end, int nb_slices, task_function function, const void *f)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = function;
+		task_f = f;
+		task_start = start;
+		task_end = end;
+		task_slices = nb_slices;
+		pending = nb_slices-1;
+		generation++;
+	}
+	wake.notify_all();
+
+	int begin, slice_end;
+	slice(0,&begin,&slice_end);
+	function(f,begin,slice_end);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while(pending > 0)
+		done.wait(lock);
+}
+
+void ThreadPool::work(int k)
+{
+	unsigned long seen = 0;
+	for(;;)
+	{
+		int begin, end;
+		task_function function;
+		const void *f;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stopping && generation == seen)
+				wake.wait(lock);
+			if(stopping)
+				return;
+			seen = generation;
+			if(k >= task_slices)
+				continue;	// not needed for this task
+			slice(k,&begin,&end);
+			function = task;
+			f = task_f;
+		}
+		function(f,begin,end);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--pending == 0)
+				done.notify_one();
+		}
+	}
+}
+
+// Kernel columns shared between trainings (see svm_kernel_store_create)
+static int *kernel_store_ids(const svm_kernel_store *store, svm_node * const *x, int l);
+static bool kernel_store_column(svm_kernel_store *store, const int *ids, int i, int start, int end, const schar *y, Qfloat *data, long long *evaluations);
+static long long kernel_store_diagonal(svm_kernel_store *store, const int *ids, int l, double *QD);
+
+//
+// Kernel evaluation
+//
+// the static method k_function is for doing single kernel evaluation
+// the constructor of Kernel prepares to calculate the l*l kernel matrix
+// the member function get_Q is for getting one column from the Q Matrix
+//
+class QMatrix {
+public:
+	virtual Qfloat *get_Q(int column, int len) const = 0;
+	virtual double *get_QD() const = 0;
+	virtual void swap_index(int i, int j) const = 0;
+	// eviction priority of column i (see Cache::set_priority), a hint
+	virtual void set_priority(int i, int priority) const {}
+	virtual ~QMatrix() {}
+};
+
+class Kernel: public QMatrix {
+public:
 	Kernel(int l, svm_node * const * x, const svm_parameter& param);
 	virtual ~Kernel();
 
 	static double k_function(const svm_node *x, const svm_node *y,
 				 const svm_parameter& param);
+	// kvalue[i] = K(x,SV[i]) for i in [0,l): the kernel type is switched on
+	// once for all the SVs. With sv_square[i] = ||SV[i]||^2 (rbf only, may be
+	// NULL), |x-SV[i]|^2 is computed from one dot product per SV.
+	static void k_row(const svm_node *x, const svm_node * const *SV, int l,
+			  const svm_parameter& param, double *kvalue,
+			  const double *sv_square = NULL);
+	static double square_norm(const svm_node *x) { return dot(x,x); }
+	static double sparse_dot(const svm_node *x, const svm_node *y) { return dot(x,y); }
 	virtual Qfloat *get_Q(int column, int len) const = 0;
 	virtual double *get_QD() const = 0;
 	virtual void swap_index(int i, int j) const	// no so const...
 	{
 		swap(x[i],x[j]);
 		if(x_square) swap(x_square[i],x_square[j]);
+		if(dense_x) swap(dense_x[i],dense_x[j]);
+		if(store_ids) swap(store_ids[i],store_ids[j]);
 	}
 protected:
 
-	double (Kernel::*kernel_function)(int i, int j) const;
+	// Kernel evaluations are specialized on the kernel type KT (see the
+	// new_*_Q factories), so that they are inlined in the Q matrix loops.
+
+	template<int KT> double kernel_value(int i, int j) const
+	{
+		return kernel_transform<KT>(kernel_product<KT>(i,j));
+	}
+
+	// data[j] = K(x_i,x_j) for j in [start,end), times y[i]*y[j] if y is not
+	// NULL: inner products first, then exp/tanh over the whole column.
+	// With a thread pool, each thread fills its own slice of [start,end).
+	// Read from svm_parameter.kernel_store when it holds every sample and
+	// has (or has room for) column i.
+	template<int KT> void kernel_column(int i, int start, int end, const schar *y, Qfloat *data) const
+	{
+		if(store_ids && kernel_store_column(store,store_ids,i,start,end,y,data,&evaluations))
+			return;
+		evaluations += end-start;
+		if(pool)
+			pool->parallel_for(start,end,[=](int begin, int slice_end) {
+				kernel_slice<KT>(i,begin,slice_end,y,data,column);
+			});
+		else
+			kernel_slice<KT>(i,start,end,y,data,column);
+	}
+
+	// kernel_column of [start,end) without the thread pool nor the kernel
+	// store, k being a scratch of at least end elements
+	template<int KT> void kernel_slice(int i, int start, int end, const schar *y, Qfloat *data, double *k) const;
+
+	// QD[i] = K(x_i,x_i) for i in [0,l)
+	template<int KT> void kernel_diagonal(int l, double *QD) const
+	{
+		if(store_ids)
+		{
+			evaluations += kernel_store_diagonal(store,store_ids,l,QD);
+			return;
+		}
+		auto diagonal = [=](int begin, int end) {
+			for(int i=begin;i<end;i++)
+				QD[i] = kernel_value<KT>(i,i);
+		};
+		evaluations += l;
+		if(pool)
+			pool->parallel_for(0,l,diagonal);
+		else
+			diagonal(0,l);
+	}
 
 private:
 	const svm_node **x;
 	double *x_square;
+	double *column;		// kernel_column scratch, l elements (slices are disjoint)
+	ThreadPool *pool;	// NULL unless svm_parameter.threads > 1
+	mutable long long evaluations;	// added to svm_parameter.stats (if any)
+	svm_training_stats *stats;
+	svm_kernel_store *store;
+	int *store_ids;		// row of each sample in the store, NULL if not read from one
+
+
+	// Dense storage: when it takes no more memory than the svm_node rows,
+	// the problem is also stored as a row-major matrix (rows padded to a
+	// multiple of the cache line) and kernels use the vectorized dot products
+	// and squared distances (see vector_kernels) instead of the sparse index
+	// merge. Rows are swapped through dense_x.
+	const svm_node_value **dense_x;
+	svm_node_value *dense_space;
+	int dense_dim;
+	void init_dense(int l);
 
 	// svm_parameter
 	const int kernel_type;
 	const int degree;
 	const double gamma;
 	const double coef0;
+	const double *gram;
+	const int gram_n;
+	const int fast_math;
 
-	static double dot(const svm_node *px, const svm_node *py);
-	double kernel_linear(int i, int j) const
+	// exp/tanh over kernel columns (see svm_parameter.fast_math)
+	const column_function exp_column;
+	const column_function tanh_column;
+
+	const double *gram_row(int i) const
 	{
-		return dot(x[i],x[j]);
+		return gram + (size_t)((int)(x[i][0].value)-1)*gram_n;
 	}
-	double kernel_poly(int i, int j) const
+
+	static double dot(const svm_node *px, const svm_node *py);
+	static double dist2(const svm_node *px, const svm_node *py);
+	static double dot(const svm_node_value *px, const svm_node_value *py, int n)
 	{
-		return powi(gamma*dot(x[i],x[j])+coef0,degree);
+		return simd_kernels.dot(px,py,n);
 	}
-	double kernel_rbf(int i, int j) const
+
+	// K(x_i,x_j) = kernel_transform(kernel_product(i,j)): the product is the
+	// inner product, or -gamma*|x_i-x_j|^2 for RBF
+	//
+	// Precomputed kernels: x[i][0].value is the (1-based) serial number of
+	// sample i. K(x_i,x_j) is read from the gram matrix when there is one,
+	// otherwise from the row itself (x[i][k].value = K(x_i,x_k)).
+	template<int KT> double kernel_product(int i, int j) const
 	{
-		return exp(-gamma*(x_square[i]+x_square[j]-2*dot(x[i],x[j])));
+		if(KT == PRECOMPUTED)
+			return gram ? gram_row(i)[(int)(x[j][0].value)-1]
+				    : x[i][(int)(x[j][0].value)].value;
+		if(dense_x)
+			return KT == RBF ? -gamma*simd_kernels.dist2(dense_x[i],dense_x[j],dense_dim)
+					 : dot(dense_x[i],dense_x[j],dense_dim);
+		return KT == RBF ? -gamma*(x_square[i]+x_square[j]-2*dot(x[i],x[j]))
+				 : dot(x[i],x[j]);
 	}
-	double kernel_sigmoid(int i, int j) const
+	template<int KT> double kernel_transform(double product) const
 	{
-		return tanh(gamma*dot(x[i],x[j])+coef0);
+		switch(KT)
+		{
+			case POLY:
+				return powi(gamma*product+coef0,degree);
+			case RBF:
+				return fast_math ? exp_fast(product) : exp(product);
+			case SIGMOID:
+				return fast_math ? tanh_fast(gamma*product+coef0) : tanh(gamma*product+coef0);
+			default:
+				return product;
+		}
 	}
-	double kernel_precomputed(int i, int j) const
+
+	template<int KT> static double k_value(const svm_node *x, const svm_node *y,
+					       const svm_parameter& param);
+	template<int KT> static void k_row_t(const svm_node *x, const svm_node * const *SV, int l,
+					     const svm_parameter& param, double *kvalue,
+					     const double *sv_square)
 	{
-		return x[i][(int)(x[j][0].value)].value;
+		int i;
+		if(KT == RBF && sv_square)
+		{
+			double x_square = dot(x,x);
+			for(i=0;i<l;i++)
+				kvalue[i] = -param.gamma*(x_square+sv_square[i]-2*dot(x,SV[i]));
+			if(param.fast_math)
+				simd_kernels.exp_fast(kvalue,l);
+			else
+				simd_kernels.exp(kvalue,l);
+		}
+		else if(param.fast_math && KT == RBF)
+		{
+			for(i=0;i<l;i++)
+				kvalue[i] = -param.gamma*dist2(x,SV[i]);
+			simd_kernels.exp_fast(kvalue,l);
+		}
+		else if(param.fast_math && KT == SIGMOID)
+		{
+			for(i=0;i<l;i++)
+				kvalue[i] = param.gamma*dot(x,SV[i])+param.coef0;
+			simd_kernels.tanh_fast(kvalue,l);
+		}
+		else
+			for(i=0;i<l;i++)
+				kvalue[i] = k_value<KT>(x,SV[i],param);
 	}
 };
 
 Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 :kernel_type(param.kernel_type), degree(param.degree),
- gamma(param.gamma), coef0(param.coef0)
+ gamma(param.gamma), coef0(param.coef0),
+ gram(param.kernel_type == PRECOMPUTED ? param.gram : 0), gram_n(param.gram_n),
+ fast_math(param.fast_math),
+ exp_column(param.fast_math ? simd_kernels.exp_fast : simd_kernels.exp),
+ tanh_column(param.fast_math ? simd_kernels.tanh_fast : simd_kernels.tanh)
 {
-	switch(kernel_type)
-	{
-		case LINEAR:
-			kernel_function = &Kernel::kernel_linear;
-			break;
-		case POLY:
-			kernel_function = &Kernel::kernel_poly;
-			break;
-		case RBF:
-			kernel_function = &Kernel::kernel_rbf;
-			break;
-		case SIGMOID:
-			kernel_function = &Kernel::kernel_sigmoid;
-			break;
-		case PRECOMPUTED:
-			kernel_function = &Kernel::kernel_precomputed;
-			break;
-	}
-
 	clone(x,x_,l);
+	store = param.kernel_store;
+	store_ids = store ? kernel_store_ids(store,x_,l) : 0;
 
 	if(kernel_type == RBF)
 	{
@@ -283,12 +1335,126 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 	}
 	else
 		x_square = 0;
+
+	column = new double[l];
+	pool = param.threads > 1 ? new ThreadPool(param.threads) : 0;
+	evaluations = 0;
+	stats = param.stats;
+
+	dense_x = 0;
+	dense_space = 0;
+	dense_dim = 0;
+	if(kernel_type != PRECOMPUTED)
+		init_dense(l);
+}
+
+void Kernel::init_dense(int l)
+{
+	int max_index = 0;
+	size_t nnz = 0;
+	for(int i=0;i<l;i++)
+	{
+		const svm_node *p = x[i];
+		for(; p->index != -1; p++)
+			nnz++;
+		if(p != x[i] && p[-1].index > max_index)
+			max_index = p[-1].index;
+	}
+
+	const int row_align = ALIGNMENT/sizeof(svm_node_value);
+	int dim = (max_index+row_align-1)/row_align*row_align;
+	double dense_size = (double)l*dim*sizeof(svm_node_value);
+	double sparse_size = (double)(nnz+l)*sizeof(svm_node);
+	if(dim == 0 || dense_size > sparse_size)
+		return;
+
+	dense_space = (svm_node_value *)aligned_malloc((size_t)l*dim*sizeof(svm_node_value));
+	if(dense_space == NULL)
+		return;
+	memset(dense_space,0,(size_t)l*dim*sizeof(svm_node_value));
+	dense_x = new const svm_node_value*[l];
+	dense_dim = dim;
+	for(int i=0;i<l;i++)
+	{
+		svm_node_value *row = dense_space + (size_t)i*dim;
+		for(const svm_node *p = x[i]; p->index != -1; p++)
+			row[p->index-1] = p->value;
+		dense_x[i] = row;
+	}
 }
 
 Kernel::~Kernel()
 {
+	if(stats)
+		stats->kernel_evaluations += evaluations;
 	delete[] x;
 	delete[] x_square;
+	delete[] column;
+	delete pool;
+	delete[] dense_x;
+	aligned_free(dense_space);
+	delete[] store_ids;
+}
+
+template<int KT> void Kernel::kernel_slice(int i, int start, int end, const schar *y, Qfloat *data, double *k) const
+{
+	int j;
+	if(KT == PRECOMPUTED && gram)
+	{
+		const double *gi = gram_row(i);
+		for(j=start;j<end;j++)
+			k[j] = gi[(int)(x[j][0].value)-1];
+	}
+	else if(KT == PRECOMPUTED)
+	{
+		for(j=start;j<end;j++)
+			k[j] = kernel_product<KT>(i,j);
+	}
+	else if(dense_x)
+	{
+		const svm_node_value *xi = dense_x[i];
+		if(KT == RBF)
+			for(j=start;j<end;j++)
+				k[j] = -gamma*simd_kernels.dist2(xi,dense_x[j],dense_dim);
+		else
+			for(j=start;j<end;j++)
+				k[j] = simd_kernels.dot(xi,dense_x[j],dense_dim);
+	}
+	else
+	{
+		if(KT == RBF)
+			for(j=start;j<end;j++)
+				k[j] = -gamma*(x_square[i]+x_square[j]-2*dot(x[i],x[j]));
+		else
+			for(j=start;j<end;j++)
+				k[j] = dot(x[i],x[j]);
+	}
+
+	switch(KT)
+	{
+		case POLY:
+			for(j=start;j<end;j++)
+				k[j] = powi(gamma*k[j]+coef0,degree);
+			break;
+		case RBF:
+			exp_column(k+start,end-start);
+			break;
+		case SIGMOID:
+			for(j=start;j<end;j++)
+				k[j] = gamma*k[j]+coef0;
+			tanh_column(k+start,end-start);
+			break;
+	}
+
+	if(y)
+	{
+		double yi = y[i];
+		for(j=start;j<end;j++)
+			data[j] = (Qfloat)(yi*y[j]*k[j]);
+	}
+	else
+		for(j=start;j<end;j++)
+			data[j] = (Qfloat)k[j];
 }
 
 double Kernel::dot(const svm_node *px, const svm_node *py)
@@ -298,7 +1464,7 @@ double Kernel::dot(const svm_node *px, const svm_node *py)
 	{
 		if(px->index == py->index)
 		{
-			sum += px->value * py->value;
+			sum += (double)px->value * py->value;
 			++px;
 			++py;
 		}
@@ -313,56 +1479,58 @@ double Kernel::dot(const svm_node *px, const svm_node *py)
 	return sum;
 }
 
-double Kernel::k_function(const svm_node *x, const svm_node *y,
-			  const svm_parameter& param)
+double Kernel::dist2(const svm_node *x, const svm_node *y)
 {
-	switch(param.kernel_type)
+	double sum = 0;
+	while(x->index != -1 && y->index !=-1)
 	{
-		case LINEAR:
-			return dot(x,y);
-		case POLY:
-			return powi(param.gamma*dot(x,y)+param.coef0,param.degree);
-		case RBF:
+		if(x->index == y->index)
 		{
-			double sum = 0;
-			while(x->index != -1 && y->index !=-1)
-			{
-				if(x->index == y->index)
-				{
-					double d = x->value - y->value;
-					sum += d*d;
-					++x;
-					++y;
-				}
-				else
-				{
-					if(x->index > y->index)
-					{	
-						sum += y->value * y->value;
-						++y;
-					}
-					else
-					{
-						sum += x->value * x->value;
-						++x;
-					}
-				}
+			double d = (double)x->value - y->value;
+			sum += d*d;
+			++x;
+			++y;
+		}
+		else
+		{
+			if(x->index > y->index)
+			{	
+				sum += (double)y->value * y->value;
+				++y;
 			}
-
-			while(x->index != -1)
+			else
 			{
-				sum += x->value * x->value;
+				sum += (double)x->value * x->value;
 				++x;
 			}
-
-			while(y->index != -1)
-			{
-				sum += y->value * y->value;
-				++y;
-			}
-			
-			return exp(-param.gamma*sum);
 		}
+	}
+
+	while(x->index != -1)
+	{
+		sum += (double)x->value * x->value;
+		++x;
+	}
+
+	while(y->index != -1)
+	{
+		sum += (double)y->value * y->value;
+		++y;
+	}
+	return sum;
+}
+
+template<int KT> double Kernel::k_value(const svm_node *x, const svm_node *y,
+					 const svm_parameter& param)
+{
+	switch(KT)
+	{
+		case LINEAR:
+			return dot(x,y);
+		case POLY:
+			return powi(param.gamma*dot(x,y)+param.coef0,param.degree);
+		case RBF:
+			return exp(-param.gamma*dist2(x,y));
 		case SIGMOID:
 			return tanh(param.gamma*dot(x,y)+param.coef0);
 		case PRECOMPUTED:  //x: test (validation), y: SV
@@ -372,6 +1540,50 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
 	}
 }
 
+double Kernel::k_function(const svm_node *x, const svm_node *y,
+			  const svm_parameter& param)
+{
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return k_value<LINEAR>(x,y,param);
+		case POLY:
+			return k_value<POLY>(x,y,param);
+		case RBF:
+			return k_value<RBF>(x,y,param);
+		case SIGMOID:
+			return k_value<SIGMOID>(x,y,param);
+		case PRECOMPUTED:
+			return k_value<PRECOMPUTED>(x,y,param);
+		default:
+			return 0;  // Unreachable
+	}
+}
+
+void Kernel::k_row(const svm_node *x, const svm_node * const *SV, int l,
+		   const svm_parameter& param, double *kvalue,
+		   const double *sv_square)
+{
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			k_row_t<LINEAR>(x,SV,l,param,kvalue,sv_square);
+			break;
+		case POLY:
+			k_row_t<POLY>(x,SV,l,param,kvalue,sv_square);
+			break;
+		case RBF:
+			k_row_t<RBF>(x,SV,l,param,kvalue,sv_square);
+			break;
+		case SIGMOID:
+			k_row_t<SIGMOID>(x,SV,l,param,kvalue,sv_square);
+			break;
+		case PRECOMPUTED:
+			k_row_t<PRECOMPUTED>(x,SV,l,param,kvalue,sv_square);
+			break;
+	}
+}
+
 // An SMO algorithm in Fan et al., JMLR 6(2005), p. 1889--1918
 // Solves:
 //
@@ -434,6 +1646,20 @@ protected:
 		else if(alpha[i] <= 0)
 			alpha_status[i] = LOWER_BOUND;
 		else alpha_status[i] = FREE;
+		update_priority(i);
+	}
+	// shrinking cache policy: drop columns of inactive variables first,
+	// keep the ones of free variables (see svm_parameter.cache_policy)
+	void update_priority(int i)
+	{
+		Q->set_priority(i,i >= active_size ? INACTIVE_COLUMN : is_free(i) ? FREE_COLUMN : BOUND_COLUMN);
+	}
+	void set_active_size(int size)
+	{
+		int start = min(size,active_size), end = max(size,active_size);
+		active_size = size;
+		for(int i=start;i<end;i++)
+			update_priority(i);
 	}
 	bool is_upper_bound(int i) { return alpha_status[i] == UPPER_BOUND; }
 	bool is_lower_bound(int i) { return alpha_status[i] == LOWER_BOUND; }
@@ -516,13 +1742,6 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	this->eps = eps;
 	unshrink = false;
 
-	// initialize alpha_status
-	{
-		alpha_status = new char[l];
-		for(int i=0;i<l;i++)
-			update_alpha_status(i);
-	}
-
 	// initialize active set (for shrinking)
 	{
 		active_set = new int[l];
@@ -531,6 +1750,13 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		active_size = l;
 	}
 
+	// initialize alpha_status
+	{
+		alpha_status = new char[l];
+		for(int i=0;i<l;i++)
+			update_alpha_status(i);
+	}
+
 	// initialize gradient
 	{
 		G = new double[l];
@@ -578,7 +1804,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 			// reconstruct the whole gradient
 			reconstruct_gradient();
 			// reset active set size and check
-			active_size = l;
+			set_active_size(l);
 			info("*");
 			if(select_working_set(i,j)!=0)
 				break;
@@ -734,7 +1960,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		{
 			// reconstruct the whole gradient to calculate objective value
 			reconstruct_gradient();
-			active_size = l;
+			set_active_size(l);
 			info("*");
 		}
 		fprintf(stderr,"\nWARNING: reaching max number of iterations\n");
@@ -943,10 +2169,11 @@ void Solver::do_shrinking()
 	{
 		unshrink = true;
 		reconstruct_gradient();
-		active_size = l;
+		set_active_size(l);
 		info("*");
 	}
 
+	int old_active_size = active_size;
 	for(i=0;i<active_size;i++)
 		if (be_shrunk(i, Gmax1, Gmax2))
 		{
@@ -961,6 +2188,8 @@ void Solver::do_shrinking()
 				active_size--;
 			}
 		}
+	for(i=active_size;i<old_active_size;i++)
+		update_priority(i);
 }
 
 double Solver::calculate_rho()
@@ -1191,9 +2420,10 @@ void Solver_NU::do_shrinking()
 	{
 		unshrink = true;
 		reconstruct_gradient();
-		active_size = l;
+		set_active_size(l);
 	}
 
+	int old_active_size = active_size;
 	for(i=0;i<active_size;i++)
 		if (be_shrunk(i, Gmax1, Gmax2, Gmax3, Gmax4))
 		{
@@ -1208,6 +2438,8 @@ void Solver_NU::do_shrinking()
 				active_size--;
 			}
 		}
+	for(i=active_size;i<old_active_size;i++)
+		update_priority(i);
 }
 
 double Solver_NU::calculate_rho()
@@ -1263,29 +2495,23 @@ double Solver_NU::calculate_rho()
 //
 // Q matrices for various formulations
 //
-class SVC_Q: public Kernel
+template<int KT> class SVC_Q: public Kernel
 { 
 public:
 	SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_)
 	:Kernel(prob.l, prob.x, param)
 	{
 		clone(y,y_,prob.l);
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new ColumnCache(prob.l,param);
 		QD = new double[prob.l];
-		for(int i=0;i<prob.l;i++)
-			QD[i] = (this->*kernel_function)(i,i);
+		kernel_diagonal<KT>(prob.l,QD);
 	}
 	
 	Qfloat *get_Q(int i, int len) const
 	{
-		Qfloat *data;
-		int start, j;
-		if((start = cache->get_data(i,&data,len)) < len)
-		{
-			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
-		}
-		return data;
+		return cache->get(i,len,[=](int start, int end, Qfloat *data) {
+			kernel_column<KT>(i,start,end,y,data);
+		});
 	}
 
 	double *get_QD() const
@@ -1301,6 +2527,11 @@ public:
 		swap(QD[i],QD[j]);
 	}
 
+	void set_priority(int i, int priority) const
+	{
+		cache->set_priority(i,priority);
+	}
+
 	~SVC_Q()
 	{
 		delete[] y;
@@ -1309,32 +2540,26 @@ public:
 	}
 private:
 	schar *y;
-	Cache *cache;
+	ColumnCache *cache;
 	double *QD;
 };
 
-class ONE_CLASS_Q: public Kernel
+template<int KT> class ONE_CLASS_Q: public Kernel
 {
 public:
 	ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
 	:Kernel(prob.l, prob.x, param)
 	{
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new ColumnCache(prob.l,param);
 		QD = new double[prob.l];
-		for(int i=0;i<prob.l;i++)
-			QD[i] = (this->*kernel_function)(i,i);
+		kernel_diagonal<KT>(prob.l,QD);
 	}
 	
 	Qfloat *get_Q(int i, int len) const
 	{
-		Qfloat *data;
-		int start, j;
-		if((start = cache->get_data(i,&data,len)) < len)
-		{
-			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(i,j);
-		}
-		return data;
+		return cache->get(i,len,[=](int start, int end, Qfloat *data) {
+			kernel_column<KT>(i,start,end,NULL,data);
+		});
 	}
 
 	double *get_QD() const
@@ -1349,35 +2574,42 @@ public:
 		swap(QD[i],QD[j]);
 	}
 
+	void set_priority(int i, int priority) const
+	{
+		cache->set_priority(i,priority);
+	}
+
 	~ONE_CLASS_Q()
 	{
 		delete cache;
 		delete[] QD;
 	}
 private:
-	Cache *cache;
+	ColumnCache *cache;
 	double *QD;
 };
 
-class SVR_Q: public Kernel
+template<int KT> class SVR_Q: public Kernel
 { 
 public:
 	SVR_Q(const svm_problem& prob, const svm_parameter& param)
 	:Kernel(prob.l, prob.x, param)
 	{
 		l = prob.l;
-		cache = new Cache(l,(long int)(param.cache_size*(1<<20)));
+		cache = new ColumnCache(l,param);
 		QD = new double[2*l];
 		sign = new schar[2*l];
 		index = new int[2*l];
+		priority = new char[2*l];
+		kernel_diagonal<KT>(l,QD);
 		for(int k=0;k<l;k++)
 		{
 			sign[k] = 1;
 			sign[k+l] = -1;
 			index[k] = k;
 			index[k+l] = k;
-			QD[k] = (this->*kernel_function)(k,k);
 			QD[k+l] = QD[k];
+			priority[k] = priority[k+l] = INACTIVE_COLUMN;
 		}
 		buffer[0] = new Qfloat[2*l];
 		buffer[1] = new Qfloat[2*l];
@@ -1393,13 +2625,10 @@ public:
 	
 	Qfloat *get_Q(int i, int len) const
 	{
-		Qfloat *data;
 		int j, real_i = index[i];
-		if(cache->get_data(real_i,&data,l) < l)
-		{
-			for(j=0;j<l;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(real_i,j);
-		}
+		const Qfloat *data = cache->get(real_i,l,[=](int start, int end, Qfloat *column) {
+			kernel_column<KT>(real_i,start,end,NULL,column);
+		});
 
 		// reorder and copy
 		Qfloat *buf = buffer[next_buffer];
@@ -1415,31 +2644,586 @@ public:
 		return QD;
 	}
 
-	~SVR_Q()
+	// variables k and k+l (alpha and alpha*) share column k: it is ranked
+	// by the better priority of the two
+	void set_priority(int i, int priority) const
+	{
+		int real_i = index[i];
+		this->priority[sign[i] > 0 ? real_i : real_i+l] = (char)priority;
+		cache->set_priority(real_i,max(this->priority[real_i],this->priority[real_i+l]));
+	}
+
+	~SVR_Q()
 	{
 		delete cache;
 		delete[] sign;
 		delete[] index;
+		delete[] priority;
 		delete[] buffer[0];
 		delete[] buffer[1];
 		delete[] QD;
 	}
 private:
 	int l;
-	Cache *cache;
+	ColumnCache *cache;
 	schar *sign;
 	int *index;
+	char *priority;		// of the variables, indexed as before swaps (see set_priority)
 	mutable int next_buffer;
 	Qfloat *buffer[2];
 	double *QD;
 };
 
+//
+// Kernel values of a classification training set, shared by its one-vs-one
+// subproblems (see SVC_VIEW_Q)
+//
+// Samples are grouped by class: class c is [start(c),start(c)+count(c)).
+// get_segment(g,c) returns K(x_g,x_j) for the samples j of class c. The
+// segment of a sample over its own class is read by the k-1 subproblems of
+// that class: it is cached, by sample, in fixed-stride slots (least recently
+// used first out). Other segments are only read by one subproblem, which
+// caches its columns anyway: they are computed in a buffer, valid until the
+// next one.
+//
+class KernelSegments
+{
+public:
+	virtual ~KernelSegments() {}
+	virtual const Qfloat *get_segment(int g, int c) = 0;
+	virtual double diagonal(int g) const = 0;
+	virtual int start(int c) const = 0;
+	virtual int count(int c) const = 0;
+	virtual long long bytes() const = 0;	// cached segments
+};
+
+template<int KT> class SHARED_Q: public Kernel, public KernelSegments
+{
+public:
+	SHARED_Q(const svm_problem& prob, const svm_parameter& param, int nr_class_, const int *start_, const int *count_)
+	:Kernel(prob.l, prob.x, param), l(prob.l), nr_class(nr_class_)
+	{
+		clone(class_start,start_,nr_class);
+		clone(class_count,count_,nr_class);
+		stride = 0;
+		for(int c=0;c<nr_class;c++)
+			stride = max(stride,class_count[c]);
+		long int size = (long int)(param.cache_size*(1<<20)) / sizeof(Qfloat);
+		nr_slots = (int)min(max(size/stride,1L),(long int)l);
+		slab = Malloc(Qfloat,(size_t)nr_slots*stride);
+		key = Malloc(int,nr_slots);
+		prev = Malloc(int,nr_slots+1);	// nr_slots is the list head
+		next = Malloc(int,nr_slots+1);
+		prev[nr_slots] = next[nr_slots] = nr_slots;
+		used = 0;
+		slot_of = Malloc(int,l);
+		for(int g=0;g<l;g++)
+			slot_of[g] = -1;
+		row = new Qfloat[l];
+		QD = new double[l];
+		kernel_diagonal<KT>(l,QD);
+	}
+
+	~SHARED_Q()
+	{
+		delete[] class_start;
+		delete[] class_count;
+		free(slab);
+		free(key);
+		free(prev);
+		free(next);
+		free(slot_of);
+		delete[] row;
+		delete[] QD;
+	}
+
+	const Qfloat *get_segment(int g, int c)
+	{
+		int begin = class_start[c], end = begin+class_count[c];
+		if(g < begin || g >= end)
+		{
+			kernel_column<KT>(g,begin,end,NULL,row);
+			return row+begin;
+		}
+		int s = slot_of[g];
+		if(s >= 0)
+		{
+			lru_delete(s);
+			lru_insert(s);
+			return slab + (size_t)s*stride;
+		}
+		if(used < nr_slots)
+			s = used++;
+		else
+		{
+			s = next[nr_slots];
+			lru_delete(s);
+			slot_of[key[s]] = -1;
+		}
+		key[s] = g;
+		slot_of[g] = s;
+		lru_insert(s);
+		Qfloat *segment = slab + (size_t)s*stride;
+		kernel_column<KT>(g,begin,end,NULL,row);
+		memcpy(segment,row+begin,sizeof(Qfloat)*(end-begin));
+		return segment;
+	}
+
+	double diagonal(int g) const { return QD[g]; }
+	int start(int c) const { return class_start[c]; }
+	int count(int c) const { return class_count[c]; }
+	long long bytes() const { return (long long)nr_slots*stride*sizeof(Qfloat) + (long long)l*sizeof(int); }
+
+	// the whole kernel matrix, as a Q matrix (not used for training)
+	Qfloat *get_Q(int i, int len) const
+	{
+		kernel_column<KT>(i,0,len,NULL,row);
+		return row;
+	}
+
+	double *get_QD() const
+	{
+		return QD;
+	}
+
+	void swap_index(int i, int j) const
+	{
+		// samples keep their order: subproblems swap their own view of them
+	}
+
+private:
+	int l;
+	int nr_class;
+	int *class_start;
+	int *class_count;
+	int stride;		// largest class
+	int nr_slots;
+	Qfloat *slab;		// nr_slots segments of stride elements
+	int *key;		// sample whose segment each slot holds
+	int *prev, *next;	// LRU list of the used slots
+	int used;		// slots [0,used) hold a segment
+	int *slot_of;		// slot of the segment of each sample, -1 if not cached
+	Qfloat *row;		// other segments
+	double *QD;
+
+	void lru_delete(int s)
+	{
+		next[prev[s]] = next[s];
+		prev[next[s]] = prev[s];
+	}
+	void lru_insert(int s)
+	{
+		next[s] = nr_slots;
+		prev[s] = prev[nr_slots];
+		next[prev[s]] = s;
+		prev[nr_slots] = s;
+	}
+};
+
+// Subproblem (class_i,class_j) of a one-vs-one training reading its kernel
+// values from segments shared with the other subproblems
+struct svc_subproblem
+{
+	KernelSegments *segments;
+	int class_i, class_j;
+};
+
+//
+// Q matrix of a one-vs-one subproblem: columns are cached as with SVC_Q,
+// but computed from the two kernel segments of their sample (its own class
+// and the other one) instead of kernel evaluations. Local sample k is
+// sample global[k] of the whole training set, of class c[side[k]].
+//
+class SVC_VIEW_Q: public QMatrix
+{
+public:
+	SVC_VIEW_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_, const svc_subproblem& sub)
+	:segments(sub.segments)
+	{
+		int l = prob.l;
+		c[0] = sub.class_i;
+		c[1] = sub.class_j;
+		int count_i = segments->count(c[0]);
+		clone(y,y_,l);
+		global = new int[l];
+		side = new char[l];
+		QD = new double[l];
+		for(int k=0;k<l;k++)
+		{
+			side[k] = k < count_i ? 0 : 1;
+			global[k] = side[k] ? segments->start(c[1])+k-count_i : segments->start(c[0])+k;
+			QD[k] = segments->diagonal(global[k]);
+		}
+		cache = new ColumnCache(l,param,segments->bytes());
+	}
+
+	Qfloat *get_Q(int i, int len) const
+	{
+		return cache->get(i,len,[=](int start, int end, Qfloat *data) {
+			const Qfloat *segment[2];
+			segment[0] = segments->get_segment(global[i],c[0]);
+			segment[1] = segments->get_segment(global[i],c[1]);
+			int offset[2] = { segments->start(c[0]), segments->start(c[1]) };
+			Qfloat yi = y[i];
+			for(int t=start;t<end;t++)
+				data[t] = yi*y[t]*segment[(int)side[t]][global[t]-offset[(int)side[t]]];
+		});
+	}
+
+	double *get_QD() const
+	{
+		return QD;
+	}
+
+	void swap_index(int i, int j) const
+	{
+		cache->swap_index(i,j);
+		swap(y[i],y[j]);
+		swap(global[i],global[j]);
+		swap(side[i],side[j]);
+		swap(QD[i],QD[j]);
+	}
+
+	void set_priority(int i, int priority) const
+	{
+		cache->set_priority(i,priority);
+	}
+
+	~SVC_VIEW_Q()
+	{
+		delete cache;
+		delete[] y;
+		delete[] global;
+		delete[] side;
+		delete[] QD;
+	}
+private:
+	KernelSegments *segments;
+	int c[2];
+	schar *y;
+	int *global;
+	char *side;
+	double *QD;
+	ColumnCache *cache;
+};
+
+// Segments shared by the one-vs-one subproblems of a training, in a fixed
+// share of the cache budget: half of it, or less if that is enough for the
+// segments of every sample. The subproblems cache their columns in the rest
+// (see KernelSegments::bytes). NULL if the share can not hold one segment.
+static KernelSegments *new_SHARED_Q(const svm_problem& prob, const svm_parameter& param, int nr_class, const int *start, const int *count)
+{
+	int largest = 0;
+	for(int c=0;c<nr_class;c++)
+		largest = max(largest,count[c]);
+	double index_size = (double)prob.l*sizeof(int);
+	double share = min(param.cache_size*(1<<20)/2,(double)prob.l*largest*sizeof(Qfloat)+index_size);
+	svm_parameter shared_param = param;
+	shared_param.cache_size = (share-index_size)/(1<<20);
+	if(share-index_size < (double)largest*sizeof(Qfloat))
+		return NULL;
+
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return new SHARED_Q<LINEAR>(prob,shared_param,nr_class,start,count);
+		case POLY:
+			return new SHARED_Q<POLY>(prob,shared_param,nr_class,start,count);
+		case RBF:
+			return new SHARED_Q<RBF>(prob,shared_param,nr_class,start,count);
+		case SIGMOID:
+			return new SHARED_Q<SIGMOID>(prob,shared_param,nr_class,start,count);
+		default:
+			return new SHARED_Q<PRECOMPUTED>(prob,shared_param,nr_class,start,count);
+	}
+}
+
+// One switch on the kernel type per training: Q matrices are specialized on it
+static QMatrix *new_SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y, const svc_subproblem *sub)
+{
+	if(sub)
+		return new SVC_VIEW_Q(prob,param,y,*sub);
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return new SVC_Q<LINEAR>(prob,param,y);
+		case POLY:
+			return new SVC_Q<POLY>(prob,param,y);
+		case RBF:
+			return new SVC_Q<RBF>(prob,param,y);
+		case SIGMOID:
+			return new SVC_Q<SIGMOID>(prob,param,y);
+		default:
+			return new SVC_Q<PRECOMPUTED>(prob,param,y);
+	}
+}
+
+static QMatrix *new_ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
+{
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return new ONE_CLASS_Q<LINEAR>(prob,param);
+		case POLY:
+			return new ONE_CLASS_Q<POLY>(prob,param);
+		case RBF:
+			return new ONE_CLASS_Q<RBF>(prob,param);
+		case SIGMOID:
+			return new ONE_CLASS_Q<SIGMOID>(prob,param);
+		default:
+			return new ONE_CLASS_Q<PRECOMPUTED>(prob,param);
+	}
+}
+
+static QMatrix *new_SVR_Q(const svm_problem& prob, const svm_parameter& param)
+{
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return new SVR_Q<LINEAR>(prob,param);
+		case POLY:
+			return new SVR_Q<POLY>(prob,param);
+		case RBF:
+			return new SVR_Q<RBF>(prob,param);
+		case SIGMOID:
+			return new SVR_Q<SIGMOID>(prob,param);
+		default:
+			return new SVR_Q<PRECOMPUTED>(prob,param);
+	}
+}
+
+//
+// Kernel columns shared between trainings (see svm_kernel_store_create):
+// whole columns of all the samples, each computed once, by the first
+// training that reads it. The lock only guards the bookkeeping: columns are
+// computed outside of it, marked in flight so that the trainings reading
+// the same column wait for it instead of computing it again. Stored columns
+// are never evicted (a store smaller than the columns read by a search would
+// make each training compute whole columns only to lose them): once it is
+// full, trainings compute the columns it lacks themselves, for their own
+// samples only. Training kernels find their samples in it by address
+// (kernel_store_ids).
+//
+class KernelColumns
+{
+public:
+	virtual ~KernelColumns() {}
+	// data[b] = K(x_a,x_b) for all the samples b (buffer: as many doubles)
+	virtual void compute(int a, Qfloat *data, double *buffer) const = 0;
+	virtual const double *diagonal() const = 0;
+};
+
+template<int KT> class STORE_Q: public Kernel, public KernelColumns
+{
+public:
+	STORE_Q(const svm_problem& prob, const svm_parameter& param)
+	:Kernel(prob.l, prob.x, param), l(prob.l)
+	{
+		QD = new double[l];
+		kernel_diagonal<KT>(l,QD);
+	}
+
+	~STORE_Q()
+	{
+		delete[] QD;
+	}
+
+	// const and without shared scratch: called concurrently
+	void compute(int a, Qfloat *data, double *buffer) const
+	{
+		kernel_slice<KT>(a,0,l,NULL,data,buffer);
+	}
+
+	const double *diagonal() const { return QD; }
+
+	// columns are read through compute (not a Q matrix for training)
+	Qfloat *get_Q(int i, int len) const { return NULL; }
+	double *get_QD() const { return QD; }
+	void swap_index(int i, int j) const {}
+
+private:
+	int l;
+	double *QD;
+};
+
+static KernelColumns *new_STORE_Q(const svm_problem& prob, const svm_parameter& param)
+{
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return new STORE_Q<LINEAR>(prob,param);
+		case POLY:
+			return new STORE_Q<POLY>(prob,param);
+		case RBF:
+			return new STORE_Q<RBF>(prob,param);
+		case SIGMOID:
+			return new STORE_Q<SIGMOID>(prob,param);
+		default:
+			return new STORE_Q<PRECOMPUTED>(prob,param);
+	}
+}
+
+struct svm_kernel_store
+{
+	svm_parameter param;	// kernel parameters, cache_size is the store size
+	int n;
+	svm_node **x;
+	std::unordered_map<const svm_node *,int> row;	// row of each sample
+	KernelColumns *kernel;	// created on first use, with the slots
+	int nr_slots;		// columns that fit in the store
+	int used;		// slots [0,used) are taken (never freed)
+	Qfloat *slab;		// nr_slots columns of n elements
+	int *slot_of;		// slot of each column, -1 if not stored
+	bool *ready;		// slot computed (in flight otherwise)
+	std::mutex mutex;
+	std::condition_variable computed;	// a slot got ready
+};
+
+svm_kernel_store *svm_kernel_store_create(svm_node * const *x, int n, const svm_parameter *param, double size)
+{
+	if(param->kernel_type == PRECOMPUTED)
+		return NULL;
+	svm_kernel_store *store = new svm_kernel_store;
+	store->param = *param;
+	store->param.nr_weight = 0;
+	store->param.weight_label = NULL;
+	store->param.weight = NULL;
+	store->param.cache_size = size;
+	store->param.threads = 0;	// columns are computed by the trainings' threads
+	store->param.half_cache = 0;
+	store->param.cache_policy = LRU_CACHE;
+	store->param.gram = NULL;
+	store->param.gram_n = 0;
+	store->param.stats = NULL;
+	store->param.kernel_store = NULL;
+	store->n = n;
+	clone(store->x,x,n);
+	for(int a=0;a<n;a++)
+		store->row.insert(std::make_pair((const svm_node *)x[a],a));
+	store->kernel = NULL;
+	store->nr_slots = 0;
+	store->used = 0;
+	store->slab = NULL;
+	store->slot_of = NULL;
+	store->ready = NULL;
+	return store;
+}
+
+void svm_kernel_store_destroy(svm_kernel_store *store)
+{
+	if(store == NULL)
+		return;
+	delete store->kernel;
+	free(store->slab);
+	free(store->slot_of);
+	free(store->ready);
+	delete[] store->x;
+	delete store;
+}
+
+// ids[k] = row of x[k] in the store, NULL if one of them is not there
+static int *kernel_store_ids(const svm_kernel_store *store, svm_node * const *x, int l)
+{
+	int *ids = new int[l];
+	for(int k=0;k<l;k++)
+	{
+		std::unordered_map<const svm_node *,int>::const_iterator found = store->row.find(x[k]);
+		if(found == store->row.end())
+		{
+			delete[] ids;
+			return NULL;
+		}
+		ids[k] = found->second;
+	}
+	return ids;
+}
+
+// Create the store kernel and slots if needed (under the lock): kernel
+// evaluations it took
+static long long kernel_store_open(svm_kernel_store *store)
+{
+	if(store->kernel)
+		return 0;
+	int n = store->n;
+	svm_problem prob;
+	prob.l = n;
+	prob.x = store->x;
+	prob.y = NULL;
+	store->kernel = new_STORE_Q(prob,store->param);
+	double columns = floor(store->param.cache_size*(1<<20)/((double)n*sizeof(Qfloat)));
+	store->nr_slots = (int)min(columns,(double)n);
+	store->slab = Malloc(Qfloat,(size_t)store->nr_slots*n);
+	store->slot_of = Malloc(int,n);
+	for(int a=0;a<n;a++)
+		store->slot_of[a] = -1;
+	store->ready = Malloc(bool,store->nr_slots);
+	return n;
+}
+
+// Kernel::kernel_column of samples ids[], adding the kernel evaluations it
+// took to *evaluations: false if column ids[i] is not stored and the store
+// is full (the caller computes it)
+static bool kernel_store_column(svm_kernel_store *store, const int *ids, int i, int start, int end, const schar *y, Qfloat *data, long long *evaluations)
+{
+	int a = ids[i];
+	std::unique_lock<std::mutex> lock(store->mutex);
+	*evaluations += kernel_store_open(store);
+	int s = store->slot_of[a];
+	if(s < 0)
+	{
+		if(store->used == store->nr_slots)
+			return false;
+		s = store->used++;
+		store->slot_of[a] = s;
+		store->ready[s] = false;
+		lock.unlock();
+
+		double *buffer = new double[store->n];
+		store->kernel->compute(a,store->slab+(size_t)s*store->n,buffer);
+		delete[] buffer;
+		*evaluations += store->n;
+
+		lock.lock();
+		store->ready[s] = true;
+		store->computed.notify_all();
+	}
+	else
+		while(!store->ready[s])
+			store->computed.wait(lock);
+	lock.unlock();
+
+	// ready columns are never written again
+	const Qfloat *column = store->slab+(size_t)s*store->n;
+	if(y)
+	{
+		Qfloat yi = y[i];
+		for(int t=start;t<end;t++)
+			data[t] = yi*y[t]*column[ids[t]];
+	}
+	else
+		for(int t=start;t<end;t++)
+			data[t] = column[ids[t]];
+	return true;
+}
+
+// Kernel::kernel_diagonal of samples ids[]: kernel evaluations it took
+static long long kernel_store_diagonal(svm_kernel_store *store, const int *ids, int l, double *QD)
+{
+	std::lock_guard<std::mutex> lock(store->mutex);
+	long long evaluations = kernel_store_open(store);
+	const double *diagonal = store->kernel->diagonal();
+	for(int k=0;k<l;k++)
+		QD[k] = diagonal[ids[k]];
+	return evaluations;
+}
+
 //
 // construct and solve various formulations
 //
 static void solve_c_svc(
 	const svm_problem *prob, const svm_parameter* param,
-	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn)
+	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn,
+	const svc_subproblem *sub)
 {
 	int l = prob->l;
 	double *minus_ones = new double[l];
@@ -1455,8 +3239,10 @@ static void solve_c_svc(
 	}
 
 	Solver s;
-	s.Solve(l, SVC_Q(*prob,*param,y), minus_ones, y,
+	QMatrix *Q = new_SVC_Q(*prob,*param,y,sub);
+	s.Solve(l, *Q, minus_ones, y,
 		alpha, Cp, Cn, param->eps, si, param->shrinking);
+	delete Q;
 
 	double sum_alpha=0;
 	for(i=0;i<l;i++)
@@ -1474,7 +3260,7 @@ static void solve_c_svc(
 
 static void solve_nu_svc(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const svc_subproblem *sub)
 {
 	int i;
 	int l = prob->l;
@@ -1509,8 +3295,10 @@ static void solve_nu_svc(
 		zeros[i] = 0;
 
 	Solver_NU s;
-	s.Solve(l, SVC_Q(*prob,*param,y), zeros, y,
+	QMatrix *Q = new_SVC_Q(*prob,*param,y,sub);
+	s.Solve(l, *Q, zeros, y,
 		alpha, 1.0, 1.0, param->eps, si,  param->shrinking);
+	delete Q;
 	double r = si->r;
 
 	info("C = %f\n",1/r);
@@ -1552,8 +3340,10 @@ static void solve_one_class(
 	}
 
 	Solver s;
-	s.Solve(l, ONE_CLASS_Q(*prob,*param), zeros, ones,
+	QMatrix *Q = new_ONE_CLASS_Q(*prob,*param);
+	s.Solve(l, *Q, zeros, ones,
 		alpha, 1.0, 1.0, param->eps, si, param->shrinking);
+	delete Q;
 
 	delete[] zeros;
 	delete[] ones;
@@ -1581,8 +3371,10 @@ static void solve_epsilon_svr(
 	}
 
 	Solver s;
-	s.Solve(2*l, SVR_Q(*prob,*param), linear_term, y,
+	QMatrix *Q = new_SVR_Q(*prob,*param);
+	s.Solve(2*l, *Q, linear_term, y,
 		alpha2, param->C, param->C, param->eps, si, param->shrinking);
+	delete Q;
 
 	double sum_alpha = 0;
 	for(i=0;i<l;i++)
@@ -1622,8 +3414,10 @@ static void solve_nu_svr(
 	}
 
 	Solver_NU s;
-	s.Solve(2*l, SVR_Q(*prob,*param), linear_term, y,
+	QMatrix *Q = new_SVR_Q(*prob,*param);
+	s.Solve(2*l, *Q, linear_term, y,
 		alpha2, C, C, param->eps, si, param->shrinking);
+	delete Q;
 
 	info("epsilon = %f\n",-si->r);
 
@@ -1646,17 +3440,17 @@ struct decision_function
 
 static decision_function svm_train_one(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn)
+	double Cp, double Cn, const svc_subproblem *sub = NULL)
 {
 	double *alpha = Malloc(double,prob->l);
 	Solver::SolutionInfo si;
 	switch(param->svm_type)
 	{
 		case C_SVC:
-			solve_c_svc(prob,param,alpha,&si,Cp,Cn);
+			solve_c_svc(prob,param,alpha,&si,Cp,Cn,sub);
 			break;
 		case NU_SVC:
-			solve_nu_svc(prob,param,alpha,&si);
+			solve_nu_svc(prob,param,alpha,&si,sub);
 			break;
 		case ONE_CLASS:
 			solve_one_class(prob,param,alpha,&si);
@@ -1926,164 +3720,935 @@ static void svm_binary_svc_probability(
 		}
 		for(j=end;j<prob->l;j++)
 		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
+			subprob.x[k] = prob->x[perm[j]];
+			subprob.y[k] = prob->y[perm[j]];
+			++k;
+		}
+		int p_count=0,n_count=0;
+		for(j=0;j<k;j++)
+			if(subprob.y[j]>0)
+				p_count++;
+			else
+				n_count++;
+
+		if(p_count==0 && n_count==0)
+			for(j=begin;j<end;j++)
+				dec_values[perm[j]] = 0;
+		else if(p_count > 0 && n_count == 0)
+			for(j=begin;j<end;j++)
+				dec_values[perm[j]] = 1;
+		else if(p_count == 0 && n_count > 0)
+			for(j=begin;j<end;j++)
+				dec_values[perm[j]] = -1;
+		else
+		{
+			svm_parameter subparam = *param;
+			subparam.probability=0;
+			subparam.C=1.0;
+			subparam.nr_weight=2;
+			subparam.weight_label = Malloc(int,2);
+			subparam.weight = Malloc(double,2);
+			subparam.weight_label[0]=+1;
+			subparam.weight_label[1]=-1;
+			subparam.weight[0]=Cp;
+			subparam.weight[1]=Cn;
+			struct svm_model *submodel = svm_train(&subprob,&subparam);
+			for(j=begin;j<end;j++)
+			{
+				svm_predict_values(submodel,prob->x[perm[j]],&(dec_values[perm[j]]));
+				// ensure +1 -1 order; reason not using CV subroutine
+				dec_values[perm[j]] *= submodel->label[0];
+			}		
+			svm_free_and_destroy_model(&submodel);
+			svm_destroy_param(&subparam);
+		}
+		free(subprob.x);
+		free(subprob.y);
+	}		
+	sigmoid_train(prob->l,dec_values,prob->y,probA,probB);
+	free(dec_values);
+	free(perm);
+}
+
+// Parameter of the Laplace distribution of the residuals y - ymv of the
+// cross-validation predictions ymv (overwritten)
+static double svr_laplace_scale(int l, const double *y, double *ymv)
+{
+	int i;
+	double mae = 0;
+	for(i=0;i<l;i++)
+	{
+		ymv[i]=y[i]-ymv[i];
+		mae += fabs(ymv[i]);
+	}		
+	mae /= l;
+	double std=sqrt(2*mae*mae);
+	int count=0;
+	mae=0;
+	for(i=0;i<l;i++)
+		if (fabs(ymv[i]) > 5*std) 
+			count=count+1;
+		else 
+			mae+=fabs(ymv[i]);
+	mae /= (l-count);
+	info("Prob. model for test data: target value = predicted value + z,\nz: Laplace distribution e^(-|z|/sigma)/(2sigma),sigma= %g\n",mae);
+	return mae;
+}
+
+// Return parameter of a Laplace distribution 
+static double svm_svr_probability(
+	const svm_problem *prob, const svm_parameter *param)
+{
+	int nr_fold = 5;
+	double *ymv = Malloc(double,prob->l);
+
+	svm_parameter newparam = *param;
+	newparam.probability = 0;
+	svm_cross_validation(prob,&newparam,nr_fold,ymv);
+	double mae = svr_laplace_scale(prob->l,prob->y,ymv);
+	free(ymv);
+	return mae;
+}
+
+
+// label: label name, start: begin of each class, count: #data of classes, perm: indices to the original data
+// perm, length l, must be allocated before calling this subroutine
+static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **label_ret, int **start_ret, int **count_ret, int *perm)
+{
+	int l = prob->l;
+	int max_nr_class = 16;
+	int nr_class = 0;
+	int *label = Malloc(int,max_nr_class);
+	int *count = Malloc(int,max_nr_class);
+	int *data_label = Malloc(int,l);
+	int i;
+
+	for(i=0;i<l;i++)
+	{
+		int this_label = (int)prob->y[i];
+		int j;
+		for(j=0;j<nr_class;j++)
+		{
+			if(this_label == label[j])
+			{
+				++count[j];
+				break;
+			}
+		}
+		data_label[i] = j;
+		if(j == nr_class)
+		{
+			if(nr_class == max_nr_class)
+			{
+				max_nr_class *= 2;
+				label = (int *)realloc(label,max_nr_class*sizeof(int));
+				count = (int *)realloc(count,max_nr_class*sizeof(int));
+			}
+			label[nr_class] = this_label;
+			count[nr_class] = 1;
+			++nr_class;
+		}
+	}
+
+	//
+	// Labels are ordered by their first occurrence in the training set. 
+	// However, for two-class sets with -1/+1 labels and -1 appears first, 
+	// we swap labels to ensure that internally the binary SVM has positive data corresponding to the +1 instances.
+	//
+	if (nr_class == 2 && label[0] == -1 && label[1] == 1)
+	{
+		swap(label[0],label[1]);
+		swap(count[0],count[1]);
+		for(i=0;i<l;i++)
+		{
+			if(data_label[i] == 0)
+				data_label[i] = 1;
+			else
+				data_label[i] = 0;
+		}
+	}
+
+	int *start = Malloc(int,nr_class);
+	start[0] = 0;
+	for(i=1;i<nr_class;i++)
+		start[i] = start[i-1]+count[i-1];
+	for(i=0;i<l;i++)
+	{
+		perm[start[data_label[i]]] = i;
+		++start[data_label[i]];
+	}
+	start[0] = 0;
+	for(i=1;i<nr_class;i++)
+		start[i] = start[i-1]+count[i-1];
+
+	*nr_class_ret = nr_class;
+	*label_ret = label;
+	*start_ret = start;
+	*count_ret = count;
+	free(data_label);
+}
+
+//
+// Approximate training (see svm_parameter.approximation)
+//
+// Inputs are mapped to rank features z(x) such that z(x).z(y) approximates
+// K(x,y), then a linear model is trained on z: by dual coordinate descent on
+// its primal weights for C_SVC and EPSILON_SVR (O(l*rank) per pass, the bias
+// is a regularized constant feature), by the usual solvers otherwise. The
+// model only keeps the map and the primal weights of each decision
+// function: predictions cost O(rank*d) whatever the number of SVs.
+//
+//   NYSTROEM        z(x) = L^-1 K(basis,x) where basis are rank training
+//                   samples and K(basis,basis) = L L^T. The weights are
+//                   folded through L^-1 so that the model keeps K(basis,x).
+//   RANDOM_FOURIER  z_i(x) = sqrt(2/rank)*cos(basis[i].x + phase[i]) with
+//                   basis[i] ~ N(0,2*gamma*I), phase[i] ~ U[0,2pi) (rbf only).
+//                   The scale is folded into the weights.
+//
+
+#define APPROX_TWO_PI 6.283185307179586476925286766559
+
+// splitmix64: landmarks and random features only depend on approx_seed
+struct approx_random
+{
+	uint64_t state;
+	approx_random(int seed): state((uint64_t)(unsigned int)seed) {}
+	uint64_t next()
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+	double uniform()	// [0,1)
+	{
+		return (double)(next() >> 11) * (1.0/9007199254740992.0);
+	}
+	double normal()
+	{
+		double u = 1-uniform(), v = uniform();
+		return sqrt(-2*log(u))*cos(APPROX_TWO_PI*v);
+	}
+};
+
+// P = L^-1 (rank x rank, row-major lower triangular) where
+// K(basis,basis) = L L^T. Landmarks whose pivot vanishes (duplicates, low
+// rank kernels) get a zero row: their feature is always 0.
+static double *nystroem_projection(const svm_node * const *basis, int rank,
+				   const svm_parameter& param, const double *basis_square)
+{
+	int i, j, k;
+	double *L = Malloc(double,(size_t)rank*rank);
+	for(i=0;i<rank;i++)
+		Kernel::k_row(basis[i],basis,rank,param,L+(size_t)i*rank,basis_square);
+
+	double max_diag = 0;
+	for(i=0;i<rank;i++)
+		max_diag = max(max_diag,fabs(L[(size_t)i*rank+i]));
+	double tol = 1e-10*max(max_diag,1.0);
+
+	// in place Cholesky factorization (lower triangle)
+	schar *dropped = Malloc(schar,rank);
+	for(j=0;j<rank;j++)
+	{
+		double *Lj = L+(size_t)j*rank;
+		double d = Lj[j];
+		for(k=0;k<j;k++)
+			d -= Lj[k]*Lj[k];
+		dropped[j] = d <= tol;
+		if(dropped[j])
+		{
+			for(i=j;i<rank;i++)
+				L[(size_t)i*rank+j] = 0;
+			continue;
+		}
+		Lj[j] = sqrt(d);
+		for(i=j+1;i<rank;i++)
+		{
+			double *Li = L+(size_t)i*rank;
+			double s = Li[j];
+			for(k=0;k<j;k++)
+				s -= Li[k]*Lj[k];
+			Li[j] = s/Lj[j];
+		}
+	}
+
+	// P = L^-1 by forward substitution, one column at a time
+	double *P = Malloc(double,(size_t)rank*rank);
+	for(size_t n=0;n<(size_t)rank*rank;n++)
+		P[n] = 0;
+	for(int c=0;c<rank;c++)
+		for(j=c;j<rank;j++)
+		{
+			if(dropped[j])
+				continue;
+			const double *Lj = L+(size_t)j*rank;
+			double s = j == c ? 1 : 0;
+			for(k=c;k<j;k++)
+				s -= Lj[k]*P[(size_t)k*rank+c];
+			P[(size_t)j*rank+c] = s/Lj[j];
+		}
+	free(dropped);
+	free(L);
+	return P;
+}
+
+// z(x) of an approximate model, before projection (NYSTROEM) or scaling (RANDOM_FOURIER)
+static void approx_features(const svm_node *x, const svm_parameter& param, int rank,
+			    const svm_node * const *basis, const double *basis_square,
+			    const double *phase, double *z)
+{
+	if(param.approximation == NYSTROEM)
+		Kernel::k_row(x,basis,rank,param,z,basis_square);
+	else
+		for(int i=0;i<rank;i++)
+			z[i] = cos(Kernel::sparse_dot(x,basis[i])+phase[i]);
+}
+
+// w[p] = sum_i coef_i SV_i over the SVs of decision function p of a linear model
+static void linear_weights(const svm_model *linear, int rank, double **w)
+{
+	int i, k, p;
+	int nr_dec = linear->nr_class*(linear->nr_class-1)/2;
+	for(p=0;p<nr_dec;p++)
+		for(k=0;k<rank;k++)
+			w[p][k] = 0;
+
+	if(linear->nSV == NULL)	// regression or one-class
+	{
+		for(i=0;i<linear->l;i++)
+			for(const svm_node *s=linear->SV[i];s->index!=-1;s++)
+				w[0][s->index-1] += linear->sv_coef[0][i]*s->value;
+		return;
+	}
+
+	int nr_class = linear->nr_class;
+	int *start = Malloc(int,nr_class);
+	start[0] = 0;
+	for(i=1;i<nr_class;i++)
+		start[i] = start[i-1]+linear->nSV[i-1];
+	p = 0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			// same layout as svm_predict_kernel_values
+			const double *coef1 = linear->sv_coef[j-1];
+			const double *coef2 = linear->sv_coef[i];
+			for(k=start[i];k<start[i]+linear->nSV[i];k++)
+				for(const svm_node *s=linear->SV[k];s->index!=-1;s++)
+					w[p][s->index-1] += coef1[k]*s->value;
+			for(k=start[j];k<start[j]+linear->nSV[j];k++)
+				for(const svm_node *s=linear->SV[k];s->index!=-1;s++)
+					w[p][s->index-1] += coef2[k]*s->value;
+			p++;
+		}
+	free(start);
+}
+
+// Dual coordinate descent for the linear models of C_SVC and EPSILON_SVR
+// over the mapped rows idx[0..n) of Z (l x rank, row-major), as liblinear's
+// L1-loss dual solvers. w is kept up to date instead of a kernel matrix, so
+// each pass costs O(n*rank). The bias is a constant feature of value 1: w
+// has rank+1 entries and the decision function is w.z + w[rank].
+#define APPROX_MAX_ITER 1000
+
+static double approx_dot(const double *w, const svm_node_value *z, int rank)
+{
+	double s = w[rank];
+	for(int k=0;k<rank;k++)
+		s += w[k]*z[k];
+	return s;
+}
+
+static void approx_axpy(double a, const svm_node_value *z, int rank, double *w)
+{
+	for(int k=0;k<rank;k++)
+		w[k] += a*z[k];
+	w[rank] += a;
+}
+
+static double *approx_diagonal(const svm_node_value *Z, int rank, const int *idx, int n)
+{
+	double *QD = Malloc(double,n);
+	for(int i=0;i<n;i++)
+	{
+		const svm_node_value *zi = Z+(size_t)idx[i]*rank;
+		double q = 1;
+		for(int k=0;k<rank;k++)
+			q += (double)zi[k]*zi[k];
+		QD[i] = q;
+	}
+	return QD;
+}
+
+// min 1/2 a^T Q a - e^T a with 0 <= a_i <= Cp (y_i = +1) or Cn (y_i = -1)
+static void solve_approx_svc(const svm_node_value *Z, int rank, const int *idx, const schar *y, int n,
+			     double Cp, double Cn, double eps, approx_random& random, double *w)
+{
+	int i, s, iter = 0;
+	int active_size = n;
+	double PGmax_old = INF, PGmin_old = -INF;
+	double *QD = approx_diagonal(Z,rank,idx,n);
+	double *alpha = Malloc(double,n);
+	int *index = Malloc(int,n);
+	for(i=0;i<n;i++)
+	{
+		alpha[i] = 0;
+		index[i] = i;
+	}
+	for(i=0;i<=rank;i++)
+		w[i] = 0;
+
+	while(iter < APPROX_MAX_ITER)
+	{
+		double PGmax_new = -INF, PGmin_new = INF;
+		for(i=0;i<active_size;i++)
+			swap(index[i],index[i+(int)(random.uniform()*(active_size-i))]);
+
+		for(s=0;s<active_size;s++)
+		{
+			i = index[s];
+			const svm_node_value *zi = Z+(size_t)idx[i]*rank;
+			double C = y[i] > 0 ? Cp : Cn;
+			double G = y[i]*approx_dot(w,zi,rank)-1;
+			double PG = 0;
+			if(alpha[i] == 0)
+			{
+				if(G > PGmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+				else if(G < 0)
+					PG = G;
+			}
+			else if(alpha[i] == C)
+			{
+				if(G < PGmin_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+				else if(G > 0)
+					PG = G;
+			}
+			else
+				PG = G;
+
+			PGmax_new = max(PGmax_new,PG);
+			PGmin_new = min(PGmin_new,PG);
+			if(fabs(PG) > 1.0e-12)
+			{
+				double alpha_old = alpha[i];
+				alpha[i] = min(max(alpha[i]-G/QD[i],0.0),C);
+				approx_axpy((alpha[i]-alpha_old)*y[i],zi,rank,w);
+			}
+		}
+		iter++;
+
+		if(PGmax_new-PGmin_new <= eps)
+		{
+			if(active_size == n)
+				break;
+			// check the shrunk variables before stopping
+			active_size = n;
+			PGmax_old = INF;
+			PGmin_old = -INF;
+			continue;
+		}
+		PGmax_old = PGmax_new > 0 ? PGmax_new : INF;
+		PGmin_old = PGmin_new < 0 ? PGmin_new : -INF;
+	}
+	if(iter >= APPROX_MAX_ITER)
+		info("\nWARNING: reaching max number of iterations\n");
+	free(index);
+	free(alpha);
+	free(QD);
+}
+
+// min 1/2 b^T Q b - y^T b + p |b|_1 with -C <= b_i <= C
+static void solve_approx_svr(const svm_node_value *Z, int rank, const int *idx, const double *y, int n,
+			     double C, double p, double eps, approx_random& random, double *w)
+{
+	int i, s, iter = 0;
+	int active_size = n;
+	double Gmax_old = INF, Gnorm1_init = 0;
+	double *QD = approx_diagonal(Z,rank,idx,n);
+	double *beta = Malloc(double,n);
+	int *index = Malloc(int,n);
+	for(i=0;i<n;i++)
+	{
+		beta[i] = 0;
+		index[i] = i;
+	}
+	for(i=0;i<=rank;i++)
+		w[i] = 0;
+
+	while(iter < APPROX_MAX_ITER)
+	{
+		double Gmax_new = 0, Gnorm1_new = 0;
+		for(i=0;i<active_size;i++)
+			swap(index[i],index[i+(int)(random.uniform()*(active_size-i))]);
+
+		for(s=0;s<active_size;s++)
+		{
+			i = index[s];
+			const svm_node_value *zi = Z+(size_t)idx[i]*rank;
+			double G = approx_dot(w,zi,rank)-y[i];
+			double Gp = G+p, Gn = G-p;
+			double violation = 0;
+			if(beta[i] == 0)
+			{
+				if(Gp < 0)
+					violation = -Gp;
+				else if(Gn > 0)
+					violation = Gn;
+				else if(Gp > Gmax_old && Gn < -Gmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+			}
+			else if(beta[i] >= C)
+			{
+				if(Gp > 0)
+					violation = Gp;
+				else if(Gp < -Gmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+			}
+			else if(beta[i] <= -C)
+			{
+				if(Gn < 0)
+					violation = -Gn;
+				else if(Gn > Gmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+			}
+			else if(beta[i] > 0)
+				violation = fabs(Gp);
+			else
+				violation = fabs(Gn);
+			Gmax_new = max(Gmax_new,violation);
+			Gnorm1_new += violation;
+
+			// Newton direction of the piecewise quadratic
+			double H = QD[i], d;
+			if(Gp < H*beta[i])
+				d = -Gp/H;
+			else if(Gn > H*beta[i])
+				d = -Gn/H;
+			else
+				d = -beta[i];
+			if(fabs(d) < 1.0e-12)
+				continue;
+			double beta_old = beta[i];
+			beta[i] = min(max(beta[i]+d,-C),C);
+			if(beta[i] != beta_old)
+				approx_axpy(beta[i]-beta_old,zi,rank,w);
+		}
+		if(iter == 0)
+			Gnorm1_init = Gnorm1_new;
+		iter++;
+
+		if(Gnorm1_new <= eps*Gnorm1_init)
+		{
+			if(active_size == n)
+				break;
+			active_size = n;
+			Gmax_old = INF;
+			continue;
+		}
+		Gmax_old = Gmax_new;
+	}
+	if(iter >= APPROX_MAX_ITER)
+		info("\nWARNING: reaching max number of iterations\n");
+	free(index);
+	free(beta);
+	free(QD);
+}
+
+// Decision values of a 5-fold cross-validation over the rows idx[0..n), for
+// probability estimates (see svm_binary_svc_probability, svm_svr_probability)
+static void approx_cross_validation(const svm_node_value *Z, int rank, const int *idx, const double *y, int n,
+				    const svm_parameter& param, double Cp, double Cn,
+				    approx_random& random, double *dec_values)
+{
+	int i, j;
+	int nr_fold = 5;
+	int *perm = Malloc(int,n);
+	int *sub_idx = Malloc(int,n);
+	double *sub_y = Malloc(double,n);
+	schar *sub_sign = Malloc(schar,n);
+	double *w = Malloc(double,rank+1);
+	for(i=0;i<n;i++)
+		perm[i] = i;
+	for(i=0;i<n;i++)
+		swap(perm[i],perm[i+(int)(random.uniform()*(n-i))]);
+
+	for(i=0;i<nr_fold;i++)
+	{
+		int begin = i*n/nr_fold;
+		int end = (i+1)*n/nr_fold;
+		int k = 0, p_count = 0;
+		for(j=0;j<n;j++)
+			if(j < begin || j >= end)
+			{
+				sub_idx[k] = idx[perm[j]];
+				sub_y[k] = y[perm[j]];
+				sub_sign[k] = sub_y[k] > 0 ? +1 : -1;
+				p_count += sub_sign[k] > 0;
+				k++;
+			}
+
+		if(param.svm_type == EPSILON_SVR)
+			solve_approx_svr(Z,rank,sub_idx,sub_y,k,param.C,param.p,param.eps,random,w);
+		else if(p_count == 0 || p_count == k)
+		{
+			// one class left, as svm_binary_svc_probability
+			for(j=begin;j<end;j++)
+				dec_values[perm[j]] = k == 0 ? 0 : p_count > 0 ? 1 : -1;
+			continue;
+		}
+		else
+			solve_approx_svc(Z,rank,sub_idx,sub_sign,k,Cp,Cn,param.eps,random,w);
+		for(j=begin;j<end;j++)
+			dec_values[perm[j]] = approx_dot(w,Z+(size_t)idx[perm[j]]*rank,rank);
+	}
+	free(w);
+	free(sub_sign);
+	free(sub_y);
+	free(sub_idx);
+	free(perm);
+}
+
+// C_SVC (one-vs-one, as svm_train) and EPSILON_SVR on the mapped rows:
+// classes, rho, probability information and weights zw[p] over z
+static void approx_train_dual_cd(const svm_problem *prob, const svm_parameter *param,
+				 const svm_node_value *Z, int rank, approx_random& random,
+				 svm_model *model, double ***zw)
+{
+	int i, j, k;
+	int l = prob->l;
+	int *idx = Malloc(int,l);
+	for(i=0;i<l;i++)
+		idx[i] = i;
+
+	if(param->svm_type == EPSILON_SVR)
+	{
+		model->nr_class = 2;
+		model->label = NULL;
+		model->nSV = NULL;
+		model->probA = NULL;
+		model->probB = NULL;
+		if(param->probability)
+		{
+			double *ymv = Malloc(double,l);
+			approx_cross_validation(Z,rank,idx,prob->y,l,*param,0,0,random,ymv);
+			model->probA = Malloc(double,1);
+			model->probA[0] = svr_laplace_scale(l,prob->y,ymv);
+			free(ymv);
 		}
-		int p_count=0,n_count=0;
-		for(j=0;j<k;j++)
-			if(subprob.y[j]>0)
-				p_count++;
-			else
-				n_count++;
+		*zw = Malloc(double *,1);
+		(*zw)[0] = Malloc(double,rank+1);
+		solve_approx_svr(Z,rank,idx,prob->y,l,param->C,param->p,param->eps,random,(*zw)[0]);
+		model->rho = Malloc(double,1);
+		model->rho[0] = -(*zw)[0][rank];
+		free(idx);
+		return;
+	}
 
-		if(p_count==0 && n_count==0)
-			for(j=begin;j<end;j++)
-				dec_values[perm[j]] = 0;
-		else if(p_count > 0 && n_count == 0)
-			for(j=begin;j<end;j++)
-				dec_values[perm[j]] = 1;
-		else if(p_count == 0 && n_count > 0)
-			for(j=begin;j<end;j++)
-				dec_values[perm[j]] = -1;
+	int nr_class;
+	int *label = NULL;
+	int *start = NULL;
+	int *count = NULL;
+	int *perm = Malloc(int,l);
+	svm_group_classes(prob,&nr_class,&label,&start,&count,perm);
+	if(nr_class == 1)
+		info("WARNING: training data in only one class. See README for details.\n");
+
+	double *weighted_C = Malloc(double,nr_class);
+	for(i=0;i<nr_class;i++)
+		weighted_C[i] = param->C;
+	for(i=0;i<param->nr_weight;i++)
+	{
+		for(j=0;j<nr_class;j++)
+			if(param->weight_label[i] == label[j])
+				break;
+		if(j == nr_class)
+			fprintf(stderr,"WARNING: class label %d specified in weight is not found\n", param->weight_label[i]);
 		else
+			weighted_C[j] *= param->weight[i];
+	}
+
+	int nr_dec = nr_class*(nr_class-1)/2;
+	model->nr_class = nr_class;
+	model->label = label;
+	model->nSV = Malloc(int,nr_class);
+	for(i=0;i<nr_class;i++)
+		model->nSV[i] = 0;
+	model->rho = Malloc(double,nr_dec);
+	model->probA = NULL;
+	model->probB = NULL;
+	double *y = NULL, *dec_values = NULL;
+	if(param->probability)
+	{
+		model->probA = Malloc(double,nr_dec);
+		model->probB = Malloc(double,nr_dec);
+		y = Malloc(double,l);
+		dec_values = Malloc(double,l);
+	}
+	schar *sign = Malloc(schar,l);
+	*zw = Malloc(double *,nr_dec);
+
+	int p = 0;
+	for(i=0;i<nr_class;i++)
+		for(j=i+1;j<nr_class;j++)
 		{
-			svm_parameter subparam = *param;
-			subparam.probability=0;
-			subparam.C=1.0;
-			subparam.nr_weight=2;
-			subparam.weight_label = Malloc(int,2);
-			subparam.weight = Malloc(double,2);
-			subparam.weight_label[0]=+1;
-			subparam.weight_label[1]=-1;
-			subparam.weight[0]=Cp;
-			subparam.weight[1]=Cn;
-			struct svm_model *submodel = svm_train(&subprob,&subparam);
-			for(j=begin;j<end;j++)
+			int n = 0;
+			for(k=0;k<count[i];k++)
 			{
-				svm_predict_values(submodel,prob->x[perm[j]],&(dec_values[perm[j]]));
-				// ensure +1 -1 order; reason not using CV subroutine
-				dec_values[perm[j]] *= submodel->label[0];
-			}		
-			svm_free_and_destroy_model(&submodel);
-			svm_destroy_param(&subparam);
+				idx[n] = perm[start[i]+k];
+				sign[n++] = +1;
+			}
+			for(k=0;k<count[j];k++)
+			{
+				idx[n] = perm[start[j]+k];
+				sign[n++] = -1;
+			}
+			if(param->probability)
+			{
+				for(k=0;k<n;k++)
+					y[k] = sign[k];
+				approx_cross_validation(Z,rank,idx,y,n,*param,weighted_C[i],weighted_C[j],random,dec_values);
+				sigmoid_train(n,dec_values,y,model->probA[p],model->probB[p]);
+			}
+			(*zw)[p] = Malloc(double,rank+1);
+			solve_approx_svc(Z,rank,idx,sign,n,weighted_C[i],weighted_C[j],param->eps,random,(*zw)[p]);
+			model->rho[p] = -(*zw)[p][rank];
+			++p;
 		}
-		free(subprob.x);
-		free(subprob.y);
-	}		
-	sigmoid_train(prob->l,dec_values,prob->y,probA,probB);
+
+	free(sign);
 	free(dec_values);
+	free(y);
+	free(weighted_C);
+	free(start);
+	free(count);
 	free(perm);
+	free(idx);
 }
 
-// Return parameter of a Laplace distribution 
-static double svm_svr_probability(
-	const svm_problem *prob, const svm_parameter *param)
+// NU_SVC, NU_SVR and ONE_CLASS: the dual solvers of svm_train on the mapped
+// problem (their constraints on sum(alpha) do not fit coordinate descent)
+static void approx_train_smo(const svm_problem *prob, const svm_parameter *param,
+			     const svm_node_value *Z, int rank, svm_model *model, double ***zw)
 {
-	int i;
-	int nr_fold = 5;
-	double *ymv = Malloc(double,prob->l);
-	double mae = 0;
+	int i, k;
+	int l = prob->l;
+	svm_problem mapped;
+	mapped.l = l;
+	mapped.y = prob->y;
+	mapped.x = Malloc(svm_node *,l);
+	svm_node *mapped_space = Malloc(svm_node,(size_t)l*(rank+1));
+	for(i=0;i<l;i++)
+	{
+		svm_node *z = mapped.x[i] = mapped_space+(size_t)i*(rank+1);
+		for(k=0;k<rank;k++)
+		{
+			z[k].index = k+1;
+			z[k].value = Z[(size_t)i*rank+k];
+		}
+		z[rank].index = -1;
+	}
 
-	svm_parameter newparam = *param;
-	newparam.probability = 0;
-	svm_cross_validation(prob,&newparam,nr_fold,ymv);
-	for(i=0;i<prob->l;i++)
+	svm_parameter linear_param = *param;
+	linear_param.kernel_type = LINEAR;
+	linear_param.approximation = NO_APPROXIMATION;
+	linear_param.gram = NULL;
+	linear_param.kernel_store = NULL;
+	svm_model *linear = svm_train(&mapped,&linear_param);
+
+	model->nr_class = linear->nr_class;
+	model->rho = linear->rho;
+	model->probA = linear->probA;
+	model->probB = linear->probB;
+	model->label = linear->label;
+	linear->rho = linear->probA = linear->probB = NULL;
+	linear->label = NULL;
+	model->nSV = NULL;
+	if(linear->nSV)
 	{
-		ymv[i]=prob->y[i]-ymv[i];
-		mae += fabs(ymv[i]);
-	}		
-	mae /= prob->l;
-	double std=sqrt(2*mae*mae);
-	int count=0;
-	mae=0;
-	for(i=0;i<prob->l;i++)
-		if (fabs(ymv[i]) > 5*std) 
-			count=count+1;
-		else 
-			mae+=fabs(ymv[i]);
-	mae /= (prob->l-count);
-	info("Prob. model for test data: target value = predicted value + z,\nz: Laplace distribution e^(-|z|/sigma)/(2sigma),sigma= %g\n",mae);
-	free(ymv);
-	return mae;
-}
+		model->nSV = Malloc(int,model->nr_class);
+		for(i=0;i<model->nr_class;i++)
+			model->nSV[i] = 0;
+	}
 
+	int nr_dec = model->nr_class*(model->nr_class-1)/2;
+	*zw = Malloc(double *,nr_dec);
+	for(int p=0;p<nr_dec;p++)
+		(*zw)[p] = Malloc(double,rank);
+	linear_weights(linear,rank,*zw);
 
-// label: label name, start: begin of each class, count: #data of classes, perm: indices to the original data
-// perm, length l, must be allocated before calling this subroutine
-static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **label_ret, int **start_ret, int **count_ret, int *perm)
+	svm_free_and_destroy_model(&linear);
+	free(mapped_space);
+	free(mapped.x);
+}
+
+static svm_model *svm_train_approximate(const svm_problem *prob, const svm_parameter *param)
 {
+	int i, k;
 	int l = prob->l;
-	int max_nr_class = 16;
-	int nr_class = 0;
-	int *label = Malloc(int,max_nr_class);
-	int *count = Malloc(int,max_nr_class);
-	int *data_label = Malloc(int,l);
-	int i;
-
-	for(i=0;i<l;i++)
+	approx_random random(param->approx_seed);
+
+	// basis: rank distinct training samples, or random frequencies
+	int rank;
+	svm_node **basis;
+	svm_node *basis_space;
+	double *phase = NULL;
+	if(param->approximation == NYSTROEM)
 	{
-		int this_label = (int)prob->y[i];
-		int j;
-		for(j=0;j<nr_class;j++)
+		rank = min(param->approx_rank,l);
+		int *perm = Malloc(int,l);
+		for(i=0;i<l;i++)
+			perm[i] = i;
+		size_t nb_nodes = 0;
+		for(i=0;i<rank;i++)
 		{
-			if(this_label == label[j])
-			{
-				++count[j];
-				break;
-			}
+			swap(perm[i],perm[i+(int)(random.uniform()*(l-i))]);
+			const svm_node *p = prob->x[perm[i]];
+			while((p++)->index != -1)
+				nb_nodes++;
+			nb_nodes++;
 		}
-		data_label[i] = j;
-		if(j == nr_class)
+		basis = Malloc(svm_node *,rank);
+		basis_space = Malloc(svm_node,nb_nodes);
+		svm_node *x_space = basis_space;
+		for(i=0;i<rank;i++)
 		{
-			if(nr_class == max_nr_class)
+			basis[i] = x_space;
+			const svm_node *p = prob->x[perm[i]];
+			do
+				*x_space++ = *p;
+			while((p++)->index != -1);
+		}
+		free(perm);
+	}
+	else
+	{
+		rank = param->approx_rank;
+		int dim = 0;
+		for(i=0;i<l;i++)
+			for(const svm_node *p=prob->x[i];p->index!=-1;p++)
+				dim = max(dim,p->index);
+		double sigma = sqrt(2*param->gamma);
+		basis = Malloc(svm_node *,rank);
+		basis_space = Malloc(svm_node,(size_t)rank*(dim+1));
+		phase = Malloc(double,rank);
+		for(i=0;i<rank;i++)
+		{
+			basis[i] = basis_space+(size_t)i*(dim+1);
+			for(k=0;k<dim;k++)
 			{
-				max_nr_class *= 2;
-				label = (int *)realloc(label,max_nr_class*sizeof(int));
-				count = (int *)realloc(count,max_nr_class*sizeof(int));
+				basis[i][k].index = k+1;
+				basis[i][k].value = (svm_node_value)(sigma*random.normal());
 			}
-			label[nr_class] = this_label;
-			count[nr_class] = 1;
-			++nr_class;
+			basis[i][dim].index = -1;
+			phase[i] = APPROX_TWO_PI*random.uniform();
 		}
 	}
 
-	//
-	// Labels are ordered by their first occurrence in the training set. 
-	// However, for two-class sets with -1/+1 labels and -1 appears first, 
-	// we swap labels to ensure that internally the binary SVM has positive data corresponding to the +1 instances.
-	//
-	if (nr_class == 2 && label[0] == -1 && label[1] == 1)
+	double *basis_square = NULL;
+	double *projection = NULL;
+	if(param->approximation == NYSTROEM)
 	{
-		swap(label[0],label[1]);
-		swap(count[0],count[1]);
-		for(i=0;i<l;i++)
+		if(param->kernel_type == RBF)
 		{
-			if(data_label[i] == 0)
-				data_label[i] = 1;
-			else
-				data_label[i] = 0;
+			basis_square = Malloc(double,rank);
+			for(i=0;i<rank;i++)
+				basis_square[i] = Kernel::square_norm(basis[i]);
 		}
+		projection = nystroem_projection(basis,rank,*param,basis_square);
 	}
 
-	int *start = Malloc(int,nr_class);
-	start[0] = 0;
-	for(i=1;i<nr_class;i++)
-		start[i] = start[i-1]+count[i-1];
+	// mapped problem: dense z(x_i), l x rank
+	double scale = param->approximation == NYSTROEM ? 1 : sqrt(2.0/rank);
+	svm_node_value *Z = Malloc(svm_node_value,(size_t)l*rank);
+	double *kvalue = Malloc(double,rank);
 	for(i=0;i<l;i++)
 	{
-		perm[start[data_label[i]]] = i;
-		++start[data_label[i]];
+		svm_node_value *z = Z+(size_t)i*rank;
+		approx_features(prob->x[i],*param,rank,basis,basis_square,phase,kvalue);
+		for(k=0;k<rank;k++)
+		{
+			double zk = 0;
+			if(projection)
+			{
+				const double *Pk = projection+(size_t)k*rank;
+				for(int j=0;j<=k;j++)
+					zk += Pk[j]*kvalue[j];
+			}
+			else
+				zk = scale*kvalue[k];
+			z[k] = (svm_node_value)zk;
+		}
 	}
-	start[0] = 0;
-	for(i=1;i<nr_class;i++)
-		start[i] = start[i-1]+count[i-1];
+	free(kvalue);
 
-	*nr_class_ret = nr_class;
-	*label_ret = label;
-	*start_ret = start;
-	*count_ret = count;
-	free(data_label);
+	// the model keeps the classes, rho and probability information of the
+	// linear model, and its weights over the features of z
+	svm_model *model = Malloc(svm_model,1);
+	model->param = *param;
+	model->param.gram = NULL;
+	model->param.stats = NULL;
+	model->param.kernel_store = NULL;
+	model->l = 0;
+	model->SV = NULL;
+	model->sv_coef = NULL;
+	model->sv_indices = NULL;
+	model->sv_square = NULL;
+	model->free_sv = 0;
+	double **zw;
+	if(param->svm_type == C_SVC || param->svm_type == EPSILON_SVR)
+		approx_train_dual_cd(prob,param,Z,rank,random,model,&zw);
+	else
+		approx_train_smo(prob,param,Z,rank,model,&zw);
+	free(Z);
+
+	int nr_dec = model->nr_class*(model->nr_class-1)/2;
+	model->rank = rank;
+	model->basis = basis;
+	model->phase = phase;
+	model->w = Malloc(double *,nr_dec);
+	for(int p=0;p<nr_dec;p++)
+	{
+		double *w = model->w[p] = Malloc(double,rank);
+		if(projection)	// w.(P k) = (P^T w).k
+		{
+			for(k=0;k<rank;k++)
+				w[k] = 0;
+			for(int j=0;j<rank;j++)
+			{
+				const double *Pj = projection+(size_t)j*rank;
+				for(k=0;k<=j;k++)
+					w[k] += Pj[k]*zw[p][j];
+			}
+		}
+		else
+			for(k=0;k<rank;k++)
+				w[k] = scale*zw[p][k];
+		free(zw[p]);
+	}
+	free(zw);
+
+	free(projection);
+	free(basis_square);
+	svm_model_init_sv_square(model);
+	return model;
 }
 
 //
@@ -2091,9 +4656,19 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 //
 svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 {
+	if(param->approximation != NO_APPROXIMATION)
+		return svm_train_approximate(prob,param);
+
 	svm_model *model = Malloc(svm_model,1);
 	model->param = *param;
+	model->param.gram = NULL;	// training data only
+	model->param.stats = NULL;
+	model->param.kernel_store = NULL;
 	model->free_sv = 0;	// XXX
+	model->rank = 0;
+	model->basis = NULL;
+	model->phase = NULL;
+	model->w = NULL;
 
 	if(param->svm_type == ONE_CLASS ||
 	   param->svm_type == EPSILON_SVR ||
@@ -2175,8 +4750,22 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 				weighted_C[j] *= param->weight[i];
 		}
 
-		// train k*(k-1)/2 models
-		
+		// train k*(k-1)/2 models, sharing kernel values when there
+		// is more than one (segments read from the kernel store if any)
+
+		KernelSegments *segments = NULL;
+		svm_parameter sub_param = *param;
+		if(nr_class > 2 && param->share_kernel)
+		{
+			svm_problem grouped;
+			grouped.l = l;
+			grouped.x = x;
+			grouped.y = NULL;
+			segments = new_SHARED_Q(grouped,*param,nr_class,start,count);
+			if(segments)
+				sub_param.cache_size -= (double)segments->bytes()/(1<<20);
+		}
+
 		bool *nonzero = Malloc(bool,l);
 		for(i=0;i<l;i++)
 			nonzero[i] = false;
@@ -2214,7 +4803,8 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 				if(param->probability)
 					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
 
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
+				svc_subproblem sub = { segments, i, j };
+				f[p] = svm_train_one(&sub_prob,&sub_param,weighted_C[i],weighted_C[j],segments ? &sub : NULL);
 				for(k=0;k<ci;k++)
 					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
 						nonzero[si+k] = true;
@@ -2225,6 +4815,7 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 				free(sub_prob.y);
 				++p;
 			}
+		delete segments;
 
 		// build output
 
@@ -2332,6 +4923,8 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		free(nz_count);
 		free(nz_start);
 	}
+	model->sv_square = NULL;
+	svm_model_init_sv_square(model);
 	return model;
 }
 
@@ -2486,6 +5079,28 @@ int svm_get_nr_sv(const svm_model *model)
 	return model->l;
 }
 
+double svm_kernel_cache_size(int l, const svm_parameter *param)
+{
+	long int bytes = param->half_cache ? Cache<Qhalf>::full_size(l) : Cache<Qfloat>::full_size(l);
+	return ceil((double)bytes/(1<<20));
+}
+
+void svm_model_init_sv_square(svm_model *model)
+{
+	free(model->sv_square);
+	model->sv_square = NULL;
+	if(model->param.kernel_type != RBF)
+		return;
+	// approximate models: K(x,basis[i]) for NYSTROEM
+	const svm_node * const *x = model->w ? model->basis : model->SV;
+	int n = model->w ? model->rank : model->l;
+	if(n <= 0 || (model->w && model->param.approximation != NYSTROEM))
+		return;
+	model->sv_square = Malloc(double,n);
+	for(int i=0;i<n;i++)
+		model->sv_square[i] = Kernel::square_norm(x[i]);
+}
+
 double svm_get_svr_probability(const svm_model *model)
 {
 	if ((model->param.svm_type == EPSILON_SVR || model->param.svm_type == NU_SVR) &&
@@ -2498,7 +5113,42 @@ double svm_get_svr_probability(const svm_model *model)
 	}
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+// Prediction from the decision values of every decision function
+static double decide(const svm_model *model, const double *dec_values)
+{
+	int i;
+	if(model->param.svm_type == ONE_CLASS)
+		return (dec_values[0]>0)?1:-1;
+	else if(model->param.svm_type == EPSILON_SVR ||
+		model->param.svm_type == NU_SVR)
+		return dec_values[0];
+
+	int nr_class = model->nr_class;
+	int *vote = Malloc(int,nr_class);
+	for(i=0;i<nr_class;i++)
+		vote[i] = 0;
+
+	int p=0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			if(dec_values[p] > 0)
+				++vote[i];
+			else
+				++vote[j];
+			p++;
+		}
+
+	int vote_max_idx = 0;
+	for(i=1;i<nr_class;i++)
+		if(vote[i] > vote[vote_max_idx])
+			vote_max_idx = i;
+
+	free(vote);
+	return model->label[vote_max_idx];
+}
+
+double svm_predict_kernel_values(const svm_model *model, const double *kvalue, double* dec_values)
 {
 	int i;
 	if(model->param.svm_type == ONE_CLASS ||
@@ -2508,33 +5158,19 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 		double *sv_coef = model->sv_coef[0];
 		double sum = 0;
 		for(i=0;i<model->l;i++)
-			sum += sv_coef[i] * Kernel::k_function(x,model->SV[i],model->param);
+			sum += sv_coef[i] * kvalue[i];
 		sum -= model->rho[0];
 		*dec_values = sum;
-
-		if(model->param.svm_type == ONE_CLASS)
-			return (sum>0)?1:-1;
-		else
-			return sum;
 	}
 	else
 	{
 		int nr_class = model->nr_class;
-		int l = model->l;
-		
-		double *kvalue = Malloc(double,l);
-		for(i=0;i<l;i++)
-			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
 
 		int *start = Malloc(int,nr_class);
 		start[0] = 0;
 		for(i=1;i<nr_class;i++)
 			start[i] = start[i-1]+model->nSV[i-1];
 
-		int *vote = Malloc(int,nr_class);
-		for(i=0;i<nr_class;i++)
-			vote[i] = 0;
-
 		int p=0;
 		for(i=0;i<nr_class;i++)
 			for(int j=i+1;j<nr_class;j++)
@@ -2554,41 +5190,71 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 					sum += coef2[sj+k] * kvalue[sj+k];
 				sum -= model->rho[p];
 				dec_values[p] = sum;
-
-				if(dec_values[p] > 0)
-					++vote[i];
-				else
-					++vote[j];
 				p++;
 			}
 
-		int vote_max_idx = 0;
-		for(i=1;i<nr_class;i++)
-			if(vote[i] > vote[vote_max_idx])
-				vote_max_idx = i;
-
-		free(kvalue);
 		free(start);
-		free(vote);
-		return model->label[vote_max_idx];
 	}
+	return decide(model,dec_values);
 }
 
-double svm_predict(const svm_model *model, const svm_node *x)
+// Approximate models: w[p].z(x) - rho[p] (see svm_train_approximate)
+static double svm_predict_approx_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	int rank = model->rank;
+	double *z = Malloc(double,rank);
+	approx_features(x,model->param,rank,model->basis,model->sv_square,model->phase,z);
+	int nr_dec = model->nr_class*(model->nr_class-1)/2;
+	for(int p=0;p<nr_dec;p++)
+	{
+		const double *w = model->w[p];
+		double sum = 0;
+		for(int k=0;k<rank;k++)
+			sum += w[k]*z[k];
+		dec_values[p] = sum - model->rho[p];
+	}
+	free(z);
+	return decide(model,dec_values);
+}
+
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	if(model->w)
+		return svm_predict_approx_values(model, x, dec_values);
+	double *kvalue = Malloc(double,model->l);
+	Kernel::k_row(x,model->SV,model->l,model->param,kvalue,model->sv_square);
+	double pred_result = svm_predict_kernel_values(model, kvalue, dec_values);
+	free(kvalue);
+	return pred_result;
+}
+
+static double *malloc_dec_values(const svm_model *model)
 {
 	int nr_class = model->nr_class;
-	double *dec_values;
 	if(model->param.svm_type == ONE_CLASS ||
 	   model->param.svm_type == EPSILON_SVR ||
 	   model->param.svm_type == NU_SVR)
-		dec_values = Malloc(double, 1);
+		return Malloc(double, 1);
 	else 
-		dec_values = Malloc(double, nr_class*(nr_class-1)/2);
+		return Malloc(double, nr_class*(nr_class-1)/2);
+}
+
+double svm_predict(const svm_model *model, const svm_node *x)
+{
+	double *dec_values = malloc_dec_values(model);
 	double pred_result = svm_predict_values(model, x, dec_values);
 	free(dec_values);
 	return pred_result;
 }
 
+double svm_predict_kernel(const svm_model *model, const double *kvalue)
+{
+	double *dec_values = malloc_dec_values(model);
+	double pred_result = svm_predict_kernel_values(model, kvalue, dec_values);
+	free(dec_values);
+	return pred_result;
+}
+
 double svm_predict_probability(
 	const svm_model *model, const svm_node *x, double *prob_estimates)
 {
@@ -2640,6 +5306,9 @@ static const char *kernel_type_table[]=
 
 int svm_save_model(const char *model_file_name, const svm_model *model)
 {
+	if(model->w)
+		return -1;	// approximate models have no libsvm text format
+
 	FILE *fp = fopen(model_file_name,"w");
 	if(fp==NULL) return -1;
 
@@ -2887,6 +5556,23 @@ svm_model *svm_load_model(const char *model_file_name)
 	model->sv_indices = NULL;
 	model->label = NULL;
 	model->nSV = NULL;
+	model->sv_square = NULL;
+	model->rank = 0;
+	model->basis = NULL;
+	model->phase = NULL;
+	model->w = NULL;
+	model->param.gram = NULL;
+	model->param.gram_n = 0;
+	model->param.fast_math = 0;
+	model->param.threads = 0;
+	model->param.half_cache = 0;
+	model->param.cache_policy = LRU_CACHE;
+	model->param.share_kernel = 0;
+	model->param.stats = NULL;
+	model->param.kernel_store = NULL;
+	model->param.approximation = NO_APPROXIMATION;
+	model->param.approx_rank = 0;
+	model->param.approx_seed = 0;
 	
 	// read header
 	if (!read_model_header(fp, model))
@@ -2972,6 +5658,7 @@ svm_model *svm_load_model(const char *model_file_name)
 		return NULL;
 
 	model->free_sv = 1;	// XXX
+	svm_model_init_sv_square(model);
 	return model;
 }
 
@@ -3008,6 +5695,26 @@ void svm_free_model_content(svm_model* model_ptr)
 
 	free(model_ptr->nSV);
 	model_ptr->nSV = NULL;
+
+	free(model_ptr->sv_square);
+	model_ptr->sv_square = NULL;
+
+	if(model_ptr->basis && model_ptr->rank > 0)
+		free((void *)(model_ptr->basis[0]));
+	free(model_ptr->basis);
+	model_ptr->basis = NULL;
+
+	free(model_ptr->phase);
+	model_ptr->phase = NULL;
+
+	if(model_ptr->w)
+	{
+		for(int i=0;i<model_ptr->nr_class*(model_ptr->nr_class-1)/2;i++)
+			free(model_ptr->w[i]);
+	}
+	free(model_ptr->w);
+	model_ptr->w = NULL;
+	model_ptr->rank = 0;
 }
 
 void svm_free_and_destroy_model(svm_model** model_ptr_ptr)
@@ -3054,6 +5761,46 @@ const char *svm_check_parameter(const svm_parameter *param)
 	if(param->degree < 0)
 		return "degree of polynomial kernel < 0";
 
+	if(kernel_type == PRECOMPUTED && param->gram != NULL && param->gram_n <= 0)
+		return "gram_n <= 0";
+
+	// (the internal cross validation predicts from the rows of the samples)
+	if(kernel_type == PRECOMPUTED && param->gram != NULL && param->probability)
+		return "probability estimates are not supported with a gram matrix";
+
+	// approximation
+
+	int approximation = param->approximation;
+	if(approximation != NO_APPROXIMATION &&
+	   approximation != NYSTROEM &&
+	   approximation != RANDOM_FOURIER)
+		return "unknown approximation";
+
+	if(approximation != NO_APPROXIMATION)
+	{
+		if(param->approx_rank <= 0)
+			return "approx_rank <= 0";
+		if(kernel_type == PRECOMPUTED)
+			return "precomputed kernels can not be approximated";
+		if(approximation == RANDOM_FOURIER && kernel_type != RBF)
+			return "random Fourier features require the rbf kernel";
+	}
+
+	if(param->cache_policy != LRU_CACHE &&
+	   param->cache_policy != SHRINKING_CACHE)
+		return "unknown cache policy";
+
+	if(param->kernel_store)
+	{
+		const svm_parameter& kernel = param->kernel_store->param;
+		if(kernel.kernel_type != kernel_type ||
+		   kernel.degree != param->degree ||
+		   kernel.gamma != param->gamma ||
+		   kernel.coef0 != param->coef0 ||
+		   kernel.fast_math != param->fast_math)
+			return "kernel_store was created for another kernel";
+	}
+
 	// cache_size,eps,C,nu,p,shrinking
 
 	if(param->cache_size <= 0)
@@ -3086,6 +5833,13 @@ const char *svm_check_parameter(const svm_parameter *param)
 	   param->probability != 1)
 		return "probability != 0 and probability != 1";
 
+	if(param->fast_math != 0 &&
+	   param->fast_math != 1)
+		return "fast_math != 0 and fast_math != 1";
+
+	if(param->threads < 0)
+		return "threads < 0";
+
 	if(param->probability == 1 &&
 	   svm_type == ONE_CLASS)
 		return "one-class SVM probability output not supported yet";
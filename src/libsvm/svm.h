@@ -9,10 +9,23 @@ extern "C" {
 
 extern int libsvm_version;
 
+/*
+ * Define SVM_COMPACT_NODES to store feature values as float: nodes take
+ * 8 bytes instead of 16, halving memory (and memory traffic) for problems
+ * and models. Kernels still compute in double.
+ * Precomputed kernels store sample serial numbers in `value` and are then
+ * limited to 2^24 samples.
+ */
+#ifdef SVM_COMPACT_NODES
+typedef float svm_node_value;
+#else
+typedef double svm_node_value;
+#endif
+
 struct svm_node
 {
 	int index;
-	double value;
+	svm_node_value value;
 };
 
 struct svm_problem
@@ -24,6 +37,22 @@ struct svm_problem
 
 enum { C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR };	/* svm_type */
 enum { LINEAR, POLY, RBF, SIGMOID, PRECOMPUTED }; /* kernel_type */
+enum { NO_APPROXIMATION, NYSTROEM, RANDOM_FOURIER };	/* approximation */
+enum { LRU_CACHE, SHRINKING_CACHE };	/* cache_policy */
+
+/* statistics of the trainings done with svm_parameter.stats (accumulated) */
+struct svm_training_stats
+{
+	long long cache_hits;	/* kernel columns read from the cache */
+	long long cache_misses;	/* kernel columns (partly) computed */
+	long long cache_evictions;	/* kernel columns evicted to make room for others */
+	long long cache_recomputed;	/* kernel columns computed again after being evicted or dropped */
+	long long cache_bytes;	/* largest kernel cache memory allocated at once */
+	long long kernel_evaluations;	/* kernel values computed */
+	double max_cache_error;	/* largest |K - cached K| (half_cache rounding) */
+};
+
+struct svm_kernel_store;	/* see svm_kernel_store_create */
 
 struct svm_parameter
 {
@@ -32,6 +61,10 @@ struct svm_parameter
 	int degree;	/* for poly */
 	double gamma;	/* for poly/rbf/sigmoid */
 	double coef0;	/* for poly/sigmoid */
+	int fast_math;	/* approximate exp/tanh for rbf/sigmoid (training and prediction) */
+	int approximation;	/* train a linear model on an approximate kernel feature map (see svm_model.basis) */
+	int approx_rank;	/* number of landmarks (NYSTROEM) or random features (RANDOM_FOURIER) */
+	int approx_seed;	/* seed of the landmark / random feature sampling */
 
 	/* these are for training only */
 	double cache_size; /* in MB */
@@ -44,6 +77,15 @@ struct svm_parameter
 	double p;	/* for EPSILON_SVR */
 	int shrinking;	/* use the shrinking heuristics */
 	int probability; /* do probability estimates */
+	int threads;	/* threads computing kernel columns, <= 1 for none */
+	int half_cache;	/* cache kernel columns as bfloat16 (twice as many columns, about 3 significant digits) */
+	int cache_policy;	/* kernel columns evicted first: least recently used (LRU_CACHE), or */
+				/* of variables shrunk, then at bound, least recently used (SHRINKING_CACHE) */
+	int share_kernel;	/* share kernel values between the one-vs-one subproblems of more than two classes */
+	const double *gram;	/* for PRECOMPUTED: optional row-major gram_n x gram_n kernel matrix */
+	int gram_n;		/* (see Kernel::kernel_product) */
+	struct svm_training_stats *stats;	/* optional, statistics added to by svm_train */
+	struct svm_kernel_store *kernel_store;	/* optional, kernel columns shared with other trainings */
 };
 
 //
@@ -60,6 +102,15 @@ struct svm_model
 	double *probA;		/* pariwise probability information */
 	double *probB;
 	int *sv_indices;        /* sv_indices[0,...,nSV-1] are values in [1,...,num_traning_data] to indicate SVs in the training set */
+	double *sv_square;	/* ||SV[i]||^2 for rbf kernels (sv_square[l], or sv_square[rank] for basis), NULL otherwise (see svm_model_init_sv_square) */
+
+	/* approximate models (param.approximation != NO_APPROXIMATION) have no SV (l = 0) */
+	/* decision function k is w[k].z(x) - rho[k] where z_i(x) = K(x,basis[i]) (NYSTROEM) */
+	/* or z_i(x) = cos(basis[i].x + phase[i]) (RANDOM_FOURIER) */
+	int rank;		/* number of features of z */
+	struct svm_node **basis;	/* landmarks or random frequencies (basis[rank]), nodes allocated in one block */
+	double *phase;		/* RANDOM_FOURIER only (phase[rank]) */
+	double **w;		/* w[k*(k-1)/2][rank] */
 
 	/* for classification only */
 
@@ -83,10 +134,17 @@ void svm_get_labels(const struct svm_model *model, int *label);
 void svm_get_sv_indices(const struct svm_model *model, int *sv_indices);
 int svm_get_nr_sv(const struct svm_model *model);
 double svm_get_svr_probability(const struct svm_model *model);
+/* cache_size (MB) that holds the whole kernel matrix of l samples */
+double svm_kernel_cache_size(int l, const struct svm_parameter *param);
+/* set sv_square of a model whose SVs and kernel type are set (done by svm_train and svm_load_model) */
+void svm_model_init_sv_square(struct svm_model *model);
 
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
+/* kvalue[i] = K(x,SV[i]): decision from kernel values computed by the caller (e.g. precomputed kernels) */
+double svm_predict_kernel_values(const struct svm_model *model, const double *kvalue, double* dec_values);
+double svm_predict_kernel(const struct svm_model *model, const double *kvalue);
 
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
@@ -97,6 +155,19 @@ int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
 
+/*
+ * Kernel columns K(x[a],x[b]) of the samples x[0..n) for the kernel of param,
+ * for trainings that only differ by C, nu or epsilon (e.g. a parameter search):
+ * the first columns read are computed once and kept within size MB, trainings
+ * compute the others themselves (for their own samples).
+ * A training with svm_parameter.kernel_store reads it whenever all its samples
+ * are rows of x (found by address, so subsets of x qualify). Trainings may
+ * share a store concurrently. x must outlive the store.
+ * NULL for precomputed kernels.
+ */
+struct svm_kernel_store *svm_kernel_store_create(struct svm_node * const *x, int n, const struct svm_parameter *param, double size);
+void svm_kernel_store_destroy(struct svm_kernel_store *store);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,207 @@
+#ifndef _NODE_SVM_DATASET_CACHE_H
+#define _NODE_SVM_DATASET_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../libsvm/svm.h"
+#include "svm-problem.h"
+#include "mapped-file.h"
+
+//
+// Binary dataset cache
+//
+// A dataset file parsed once (see FileProblemSource) is saved next to it as
+// `<file>.svmcache`, so that later runs map the cache instead of parsing text
+// again. Nodes are stored exactly as svm_node are laid out in memory: the
+// loaded problem points into the (read-only) mapping and nodes are never copied.
+//
+// Layout (native byte order, sections aligned on 8 bytes):
+//   DatasetCacheHeader
+//   double   y[l]
+//   uint64_t rows[l]          index in `nodes` of the first node of each row
+//   svm_node nodes[nbNodes]   rows terminated by index -1
+//
+// A cache is only used when it was written from the current version of the
+// source file (same inode, size and modification time, to the nanosecond where
+// the platform reports it) by a build with the same format version and
+// svm_node layout (see SVM_COMPACT_NODES). Otherwise it is ignored and rewritten.
+//
+#define DATASET_CACHE_VERSION 2
+#define DATASET_CACHE_BYTE_ORDER 0x01020304
+
+struct DatasetCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t nodeSize;
+  int32_t l;
+  int32_t nbFeatures;
+  int32_t reserved;
+  int64_t sourceSize;
+  int64_t sourceMtime;      // seconds
+  int64_t sourceMtimeNsec;  // and nanoseconds
+  uint64_t sourceInode;
+  uint64_t nbNodes;
+};
+
+// identity of the version of a dataset file a cache was written from
+struct DatasetSourceStat {
+  int64_t size;
+  int64_t mtime;
+  int64_t mtimeNsec;
+  uint64_t inode;
+};
+
+static const char datasetCacheMagic[8] = { 'N', 'O', 'D', 'E', 'S', 'V', 'M', '\0' };
+
+static inline std::string datasetCachePath(const char *path) {
+  return std::string(path) + ".svmcache";
+}
+
+static inline bool statDatasetSource(const char *path, struct DatasetSourceStat *source) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return false;
+  source->size = (int64_t)st.st_size;
+  source->mtime = (int64_t)st.st_mtime;
+#if defined(__APPLE__)
+  source->mtimeNsec = (int64_t)st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  source->mtimeNsec = 0;  // seconds only
+#else
+  source->mtimeNsec = (int64_t)st.st_mtim.tv_nsec;
+#endif
+  source->inode = (uint64_t)st.st_ino;
+  return true;
+}
+
+// offsets of the sections following the header
+static inline void getDatasetCacheOffsets(int l, size_t *y_offset, size_t *rows_offset, size_t *nodes_offset) {
+  *y_offset = alignSvmProblemOffset(sizeof(struct DatasetCacheHeader));
+  *rows_offset = alignSvmProblemOffset(*y_offset + l * sizeof(double));
+  *nodes_offset = alignSvmProblemOffset(*rows_offset + l * sizeof(uint64_t));
+}
+
+static inline bool writeDatasetCacheSection(FILE *fp, size_t offset, const void *data, size_t size, size_t *position) {
+  static const char padding[sizeof(double)] = { 0 };
+  if (offset > *position && fwrite(padding, 1, offset - *position, fp) != offset - *position)
+    return false;
+  *position = offset + size;
+  return fwrite(data, 1, size, fp) == size;
+}
+
+// Save prob as the cache of dataset file `path`.
+// The cache is written to a temporary file first, so that concurrent runs
+// never map a partial cache. Return false if the cache could not be written.
+static bool writeDatasetCache(const char *path, const struct svm_problem *prob, int nb_features) {
+  struct DatasetCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, datasetCacheMagic, sizeof(header.magic));
+  header.version = DATASET_CACHE_VERSION;
+  header.byteOrder = DATASET_CACHE_BYTE_ORDER;
+  header.nodeSize = sizeof(struct svm_node);
+  header.l = prob->l;
+  header.nbFeatures = nb_features;
+  struct DatasetSourceStat source;
+  if (!statDatasetSource(path, &source))
+    return false;
+  header.sourceSize = source.size;
+  header.sourceMtime = source.mtime;
+  header.sourceMtimeNsec = source.mtimeNsec;
+  header.sourceInode = source.inode;
+
+  std::vector<uint64_t> rows(prob->l);
+  std::vector<size_t> rowSizes(prob->l);
+  for (int i = 0; i < prob->l; i++) {
+    const struct svm_node *p = prob->x[i];
+    while (p->index != -1)
+      p++;
+    rows[i] = header.nbNodes;
+    rowSizes[i] = (p - prob->x[i]) + 1;
+    header.nbNodes += rowSizes[i];
+  }
+
+  size_t y_offset, rows_offset, nodes_offset;
+  getDatasetCacheOffsets(prob->l, &y_offset, &rows_offset, &nodes_offset);
+
+  std::string cache_path = datasetCachePath(path);
+  std::string tmp_path = cache_path + ".tmp";
+  FILE *fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+  size_t position = 0;
+  bool ok = writeDatasetCacheSection(fp, 0, &header, sizeof(header), &position) &&
+            writeDatasetCacheSection(fp, y_offset, prob->y, prob->l * sizeof(double), &position) &&
+            writeDatasetCacheSection(fp, rows_offset, &rows[0], prob->l * sizeof(uint64_t), &position);
+  for (int i = 0; ok && i < prob->l; i++) {
+    size_t offset = nodes_offset + rows[i] * sizeof(struct svm_node);
+    ok = writeDatasetCacheSection(fp, offset, prob->x[i], rowSizes[i] * sizeof(struct svm_node), &position);
+  }
+  ok = fclose(fp) == 0 && ok;
+#ifdef _WIN32
+  // rename does not replace existing files on windows
+  remove(cache_path.c_str());
+#endif
+  if (!ok || rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+    remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Load the cache of dataset file `path`. Return NULL if there is no fresh cache.
+// The problem rows point into the cache mapping, which is appended to `owners`
+// and released with the last problem using it.
+static struct svm_problem *loadDatasetCache(const char *path, int *nb_features, std::vector<SharedSvmProblem> &owners) {
+  struct DatasetSourceStat source;
+  if (!statDatasetSource(path, &source))
+    return NULL;
+
+  std::shared_ptr<MappedFile> file(new MappedFile());
+  if (!file->open(datasetCachePath(path).c_str(), false) || file->size < sizeof(struct DatasetCacheHeader))
+    return NULL;
+  struct DatasetCacheHeader header;
+  memcpy(&header, file->data, sizeof(header));
+  if (memcmp(header.magic, datasetCacheMagic, sizeof(header.magic)) != 0 ||
+      header.version != DATASET_CACHE_VERSION ||
+      header.byteOrder != DATASET_CACHE_BYTE_ORDER ||
+      header.nodeSize != sizeof(struct svm_node) ||
+      header.sourceSize != source.size ||
+      header.sourceMtime != source.mtime ||
+      header.sourceMtimeNsec != source.mtimeNsec ||
+      header.sourceInode != source.inode ||
+      header.l <= 0 || header.nbNodes == 0)
+    return NULL;
+
+  size_t y_offset, rows_offset, nodes_offset;
+  getDatasetCacheOffsets(header.l, &y_offset, &rows_offset, &nodes_offset);
+  if (file->size != nodes_offset + header.nbNodes * sizeof(struct svm_node))
+    return NULL;
+  const double *y = (const double *)(file->data + y_offset);
+  const uint64_t *rows = (const uint64_t *)(file->data + rows_offset);
+  struct svm_node *nodes = (struct svm_node *)(file->data + nodes_offset);
+  if (nodes[header.nbNodes - 1].index != -1)
+    return NULL;
+
+  struct svm_problem *prob = allocSvmProblem(header.l, 0);
+  for (int i = 0; i < header.l; i++) {
+    if (rows[i] >= header.nbNodes) {
+      freeSvmProblem(prob);
+      return NULL;
+    }
+    prob->y[i] = y[i];
+    prob->x[i] = nodes + rows[i];
+  }
+  *nb_features = header.nbFeatures;
+  // owner of the mapping only: it does not point to a problem of its own
+  owners.push_back(SharedSvmProblem(file, (struct svm_problem *)NULL));
+  return prob;
+}
+
+#endif /* _NODE_SVM_DATASET_CACHE_H */
@@ -0,0 +1,212 @@
+
+#include "dataset.h"
+#include "file-problem-source.h"
+
+using v8::FunctionTemplate;
+using v8::Object;
+using v8::String;
+using v8::Array;
+using v8::ArrayBuffer;
+using v8::Int32Array;
+
+Nan::Persistent<Function> Dataset::constructor;
+Nan::Persistent<FunctionTemplate> Dataset::constructorTemplate;
+
+bool Dataset::HasInstance(Local<Value> value) {
+    return Nan::New(constructorTemplate)->HasInstance(value);
+}
+
+NAN_METHOD(Dataset::New) {
+    Nan::HandleScope scope;
+
+    if (info.IsConstructCall()) {
+        // Invoked as constructor: `new Dataset()`
+        Dataset* obj = new Dataset();
+        obj->Wrap(info.This());
+        info.GetReturnValue().Set(info.This());
+    }
+    else {
+        // Invoked as plain function `Dataset()`, turn into construct call.
+        const int argc = 0;
+#ifdef _WIN32
+    // On windows you get "error C2466: cannot allocate an array of constant size 0" and we use a pointer
+    Local<Value>* argv;
+#else
+    Local<Value> argv[argc];
+#endif
+        Local<Function> cons = Nan::New<Function>(constructor);
+        info.GetReturnValue().Set(Nan::NewInstance(cons, argc, argv).ToLocalChecked());
+    }
+}
+
+// Build the rows right away and append them. Invalid data is reported as a JS exception.
+static void append(Dataset *obj, ProblemSource *source) {
+    struct svm_problem *prob = source->build();
+    if (prob == NULL) {
+        Nan::ThrowError(source->error);
+    }
+    else {
+        obj->appendProblem(prob, source->nbFeatures, source->nodeOwners);
+    }
+    delete source;
+}
+
+// expects [[x0, y0], [x1, y1], ...] (see NodeSvm::Train)
+NAN_METHOD(Dataset::AppendRows) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+
+    // chech params
+    assert(info[0]->IsArray());
+
+    append(obj, new ArrayProblemSource(info[0].As<Array>()));
+}
+
+// expects (features, nbRows, nbFeatures, labels) (see newMatrixProblemSource)
+NAN_METHOD(Dataset::AppendMatrix) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+
+    append(obj, newMatrixProblemSource(info));
+}
+
+// expects (indptr, indices, values, labels) (see newCsrProblemSource)
+NAN_METHOD(Dataset::AppendCsr) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+
+    append(obj, newCsrProblemSource(info));
+}
+
+// expects (path, cache), see FileProblemSource
+NAN_METHOD(Dataset::AppendFile) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+
+    // chech params
+    assert(info[0]->IsString());
+
+    Nan::Utf8String path(info[0]);
+    append(obj, new FileProblemSource(*path, info[1]->BooleanValue()));
+}
+
+NAN_METHOD(Dataset::Size) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+    info.GetReturnValue().Set(Nan::New<Number>(obj->size()));
+}
+
+NAN_METHOD(Dataset::GetNbFeatures) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+    info.GetReturnValue().Set(Nan::New<Number>(obj->nbFeatures));
+}
+
+static Local<Int32Array> newInt32Array(const int *values, int length) {
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(v8::Isolate::GetCurrent(), length * sizeof(int32_t));
+    Local<Int32Array> array = Int32Array::New(buffer, 0, length);
+    Nan::TypedArrayContents<int32_t> contents(array);
+    for (int i = 0; i < length; i++) {
+        (*contents)[i] = values[i];
+    }
+    return array;
+}
+
+// expects (kFold, stratified), returns kFold {train, test} objects where
+// train and test are Int32Array of row indexes
+NAN_METHOD(Dataset::SplitFolds) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+
+    // chech params
+    assert(info[0]->IsInt32());
+    int nr_fold = info[0]->IntegerValue();
+    assert(nr_fold > 0 && nr_fold <= obj->size());
+    bool stratified = info[1]->BooleanValue();
+
+    std::vector<int> perm;
+    std::vector<int> fold_start;
+    obj->splitFolds(nr_fold, stratified, perm, fold_start);
+
+    Local<String> str_train = Nan::New<String>("train").ToLocalChecked();
+    Local<String> str_test = Nan::New<String>("test").ToLocalChecked();
+    Local<Array> folds = Nan::New<Array>(nr_fold);
+    int l = perm.size();
+    std::vector<int> train;
+    for (int i = 0; i < nr_fold; i++) {
+        int begin = fold_start[i];
+        int end = fold_start[i+1];
+        Local<Object> fold = Nan::New<Object>();
+        fold->Set(str_test, newInt32Array(&perm[0] + begin, end - begin));
+        if (nr_fold == 1) {
+            // train and test on the whole dataset
+            fold->Set(str_train, newInt32Array(&perm[0], l));
+        }
+        else {
+            train.assign(perm.begin(), perm.begin() + begin);
+            train.insert(train.end(), perm.begin() + end, perm.end());
+            fold->Set(str_train, newInt32Array(&train[0], train.size()));
+        }
+        folds->Set(i, fold);
+    }
+    info.GetReturnValue().Set(folds);
+}
+
+// returns [[x0, y0], [x1, y1], ...] where xi are dense arrays of nbFeatures values
+NAN_METHOD(Dataset::ToArray) {
+    Nan::HandleScope scope;
+    Dataset *obj = Nan::ObjectWrap::Unwrap<Dataset>(info.This());
+
+    int l = obj->size();
+    int n = obj->nbFeatures;
+    std::vector<double> x(n);
+    Local<Array> dataset = Nan::New<Array>(l);
+    for (int i = 0; i < l; i++) {
+        obj->getDenseRow(i, x.empty() ? NULL : &x[0]);
+        Local<Array> jsX = Nan::New<Array>(n);
+        for (int j = 0; j < n; j++) {
+            jsX->Set(j, Nan::New<Number>(x[j]));
+        }
+        Local<Array> example = Nan::New<Array>(2);
+        example->Set(0, jsX);
+        example->Set(1, Nan::New<Number>(obj->getLabel(i)));
+        dataset->Set(i, example);
+    }
+    info.GetReturnValue().Set(dataset);
+}
+
+void Dataset::Init(Local<Object> exports){
+    // Prepare constructor template
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(Dataset::New);
+    tpl->SetClassName(Nan::New<String>("Dataset").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // prototype
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("appendRows").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::AppendRows));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("appendMatrix").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::AppendMatrix));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("appendCsr").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::AppendCsr));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("appendFile").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::AppendFile));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("size").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::Size));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("getNbFeatures").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::GetNbFeatures));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("splitFolds").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::SplitFolds));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("toArray").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(Dataset::ToArray));
+
+    exports->Set(Nan::New<String>("Dataset").ToLocalChecked(), tpl->GetFunction());
+    constructor.Reset(Nan::GetFunction(tpl).ToLocalChecked());
+    constructorTemplate.Reset(tpl);
+}
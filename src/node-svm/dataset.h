@@ -0,0 +1,211 @@
+#ifndef _NODE_SVM_DATASET_H
+#define _NODE_SVM_DATASET_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <node.h>
+#include <nan.h>
+#include "../libsvm/svm.h"
+#include "svm-problem.h"
+#include "problem-source.h"
+
+using namespace v8;
+
+// Training problem whose nodes live in a Dataset: the problem only holds
+// row pointers and labels, gathered on the main thread. Its kernel columns
+// may be read from a store shared with other trainings on the dataset.
+class DatasetProblemSource : public ProblemSource {
+ public:
+  DatasetProblemSource(struct svm_problem *prob, int nb_features, const std::vector<SharedSvmProblem> &chunks, const char *gatherError)
+    : prob(prob), gatherError(gatherError) {
+      nbFeatures = nb_features;
+      nodeOwners = chunks;
+    }
+  ~DatasetProblemSource() {
+    if (prob != NULL)
+      freeSvmProblem(prob);
+  }
+
+  struct svm_problem *build() {
+    error = gatherError;
+    struct svm_problem *built = prob;
+    prob = NULL;
+    return built;
+  }
+
+ private:
+  struct svm_problem *prob;
+  const char *gatherError;
+};
+
+//
+// Training examples converted to svm_node once and shared by any number
+// of trainings (optionally on a subset of the rows, e.g. CV folds).
+//
+// Rows are stored in chunks, one per append. Chunks are never modified nor
+// moved: trainings (and the models they produce) keep a reference on the
+// chunks so the dataset can grow or be garbage collected meanwhile.
+//
+class Dataset : public Nan::ObjectWrap
+{
+    public:
+        static void Init(Local<Object> exports);
+        static bool HasInstance(Local<Value> value);
+        static NAN_METHOD(New);
+        static NAN_METHOD(AppendRows);
+        static NAN_METHOD(AppendMatrix);
+        static NAN_METHOD(AppendCsr);
+        static NAN_METHOD(AppendFile);
+        static NAN_METHOD(Size);
+        static NAN_METHOD(GetNbFeatures);
+        static NAN_METHOD(SplitFolds);
+        static NAN_METHOD(ToArray);
+
+        Dataset() : nbFeatures(0) {}
+
+        int size(){ return (int)rows.size(); }
+
+        // Take ownership of prob and append its rows. `owners` holds the
+        // storage the rows live in when it is not prob itself (see ProblemSource)
+        void appendProblem(struct svm_problem *prob, int nb_features, const std::vector<SharedSvmProblem> &owners){
+            chunks.push_back(shareSvmProblem(prob));
+            chunks.insert(chunks.end(), owners.begin(), owners.end());
+            for (int i = 0; i < prob->l; i++) {
+                rows.push_back(prob->x[i]);
+                labels.push_back(prob->y[i]);
+            }
+            if (nb_features > nbFeatures)
+                nbFeatures = nb_features;
+        };
+
+        // Row i as nbFeatures dense values
+        void getDenseRow(int i, double *x){
+            for (int j = 0; j < nbFeatures; j++)
+                x[j] = 0;
+            for (const struct svm_node *p = rows[i]; p->index != -1; p++)
+                x[p->index - 1] = p->value;
+        };
+
+        double getLabel(int i){ return labels[i]; }
+
+        // Source for a training with params on rows subset[0..nb_rows) (all rows if
+        // subset is NULL), sharing kernel columns within kernel_store_size MB (if > 0)
+        ProblemSource *newProblemSource(const int32_t *subset, int nb_rows, const struct svm_parameter *params, double kernel_store_size){
+            if (nb_rows <= 0) {
+                return new DatasetProblemSource(NULL, nbFeatures, chunks, "training set is empty");
+            }
+            struct svm_problem *prob = allocSvmProblem(nb_rows, 0);
+            for (int i = 0; i < nb_rows; i++) {
+                int row = subset == NULL ? i : subset[i];
+                if (row < 0 || row >= size()) {
+                    freeSvmProblem(prob);
+                    return new DatasetProblemSource(NULL, nbFeatures, chunks, "row index out of range");
+                }
+                prob->x[i] = rows[row];
+                prob->y[i] = labels[row];
+            }
+            ProblemSource *source = new DatasetProblemSource(prob, nbFeatures, chunks, NULL);
+            source->kernelStore = getKernelStore(params, kernel_store_size);
+            return source;
+        };
+
+        // Kernel columns of all the rows for the kernel of params, shared by the
+        // trainings that only differ by C, nu or epsilon (see svm_kernel_store_create),
+        // none if size_mb <= 0. A dataset keeps one store, the last one used: a
+        // search trains the values of C of a kernel one after the other (see
+        // grid-search). Trainings keep the store they use until they are done,
+        // so at most size_mb per kernel being trained.
+        SharedKernelStore getKernelStore(const struct svm_parameter *params, double size_mb){
+            if (size_mb <= 0 || size() == 0 ||
+                params->kernel_type == PRECOMPUTED ||
+                params->approximation != NO_APPROXIMATION) {
+                return SharedKernelStore();
+            }
+            if (kernelStore.store && kernelStore.nbRows == size() && kernelStore.size == size_mb &&
+                sameKernel(kernelStore.kernel, *params)) {
+                return kernelStore.store;
+            }
+            kernelStore.kernel = *params;
+            kernelStore.nbRows = size();
+            kernelStore.size = size_mb;
+            kernelStore.store = SharedKernelStore(svm_kernel_store_create(rows.data(), size(), params, size_mb), svm_kernel_store_destroy);
+            return kernelStore.store;
+        };
+
+        // Shuffle rows into nr_fold folds, the way svm_cross_validation does:
+        // fold i is perm[fold_start[i]..fold_start[i+1]). If stratified, each
+        // class is spread evenly among folds.
+        void splitFolds(int nr_fold, bool stratified, std::vector<int> &perm, std::vector<int> &fold_start){
+            int l = size();
+            assert(nr_fold > 0 && nr_fold <= l);
+            perm.resize(l);
+            fold_start.resize(nr_fold + 1);
+            if (!stratified || nr_fold == l) {
+                for (int i = 0; i < l; i++)
+                    perm[i] = i;
+                for (int i = 0; i < l; i++)
+                    std::swap(perm[i], perm[i + rand() % (l - i)]);
+                for (int i = 0; i <= nr_fold; i++)
+                    fold_start[i] = (int)((long long)i * l / nr_fold);
+                return;
+            }
+
+            // group rows by class, then shuffle each class
+            std::vector<int> classLabels;
+            std::vector<std::vector<int> > classRows;
+            for (int i = 0; i < l; i++) {
+                int label = (int)labels[i];
+                size_t c = std::find(classLabels.begin(), classLabels.end(), label) - classLabels.begin();
+                if (c == classLabels.size()) {
+                    classLabels.push_back(label);
+                    classRows.push_back(std::vector<int>());
+                }
+                classRows[c].push_back(i);
+            }
+            for (size_t c = 0; c < classRows.size(); c++) {
+                std::vector<int> &class_rows = classRows[c];
+                int count = class_rows.size();
+                for (int i = 0; i < count; i++)
+                    std::swap(class_rows[i], class_rows[i + rand() % (count - i)]);
+            }
+
+            // fold i gets the i-th slice of every class
+            int k = 0;
+            for (int i = 0; i < nr_fold; i++) {
+                fold_start[i] = k;
+                for (size_t c = 0; c < classRows.size(); c++) {
+                    int count = classRows[c].size();
+                    for (int j = i * count / nr_fold; j < (i + 1) * count / nr_fold; j++)
+                        perm[k++] = classRows[c][j];
+                }
+            }
+            fold_start[nr_fold] = k;
+        };
+
+    private:
+        ~Dataset() {}
+        std::vector<SharedSvmProblem> chunks;
+        std::vector<struct svm_node *> rows;
+        std::vector<double> labels;
+        int nbFeatures;
+
+        struct KernelStoreEntry {
+            struct svm_parameter kernel;  // kernel parameters of the store
+            int nbRows;                   // rows of the dataset when it was created
+            double size;                  // MB
+            SharedKernelStore store;
+        };
+        KernelStoreEntry kernelStore;  // last one used (see getKernelStore)
+
+        static bool sameKernel(const struct svm_parameter &a, const struct svm_parameter &b){
+            return a.kernel_type == b.kernel_type && a.degree == b.degree && a.gamma == b.gamma &&
+                   a.coef0 == b.coef0 && a.fast_math == b.fast_math;
+        }
+        static Nan::Persistent<Function> constructor;
+        static Nan::Persistent<FunctionTemplate> constructorTemplate;
+};
+
+#endif /* _NODE_SVM_DATASET_H */
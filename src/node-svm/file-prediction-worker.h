@@ -0,0 +1,66 @@
+#ifndef _NODE_SVM_FILE_PREDICTION_WORKER_H
+#define _NODE_SVM_FILE_PREDICTION_WORKER_H
+
+#include <vector>
+#include "node-svm.h"
+#include "file-problem-source.h"
+
+using namespace v8;
+
+// Predict every example of a dataset file (see FileProblemSource).
+// Expected labels found in the file are reported alongside predictions.
+class FilePredictionWorker : public Nan::AsyncWorker {
+ public:
+  FilePredictionWorker(NodeSvm *svm, const char *path, Nan::Callback *callback)
+    : Nan::AsyncWorker(callback), source(path) {
+      obj = svm;
+      // keep the classifier (and the memory it owns) alive until the work is done
+      SaveToPersistent("svm", svm->handle());
+    }
+  ~FilePredictionWorker() {}
+
+  // Executed inside the worker-thread.
+  // It is not safe to access V8, or V8 data structures
+  // here, so everything we need for input and output
+  // should go on `this`.
+  void Execute () {
+    struct svm_problem *prob = source.build();
+    if (prob == NULL) {
+      SetErrorMessage(source.error);
+      return;
+    }
+    predictions.resize(prob->l);
+    expected.assign(prob->y, prob->y + prob->l);
+    for (int i = 0; i < prob->l; i++) {
+      predictions[i] = obj->predict(prob->x[i]);
+    }
+    freeSvmProblem(prob);
+  }
+
+  // Executed when the async work is complete
+  // this function will be run inside the main event loop
+  // so it is safe to use V8 again
+  void HandleOKCallback () {
+    Nan::HandleScope scope;
+    Local<Array> jsPredictions = Nan::New<Array>(predictions.size());
+    Local<Array> jsExpected = Nan::New<Array>(expected.size());
+    for (unsigned i = 0; i < predictions.size(); i++) {
+      jsPredictions->Set(i, Nan::New<Number>(predictions[i]));
+      jsExpected->Set(i, Nan::New<Number>(expected[i]));
+    }
+    Local<Value> argv[] = {
+        Nan::Null(),
+        jsPredictions,
+        jsExpected
+    };
+    callback->Call(3, argv);
+  };
+
+ private:
+  NodeSvm *obj;
+  FileProblemSource source;
+  std::vector<double> predictions;
+  std::vector<double> expected;
+};
+
+#endif /* _NODE_SVM_FILE_PREDICTION_WORKER_H */
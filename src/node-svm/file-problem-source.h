@@ -0,0 +1,255 @@
+#ifndef _NODE_SVM_FILE_PROBLEM_SOURCE_H
+#define _NODE_SVM_FILE_PROBLEM_SOURCE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <string>
+#include "../libsvm/svm.h"
+#include "svm-problem.h"
+#include "problem-source.h"
+#include "mapped-file.h"
+#include "dataset-cache.h"
+
+//
+// Dataset file parsed straight into an svm_problem (see ProblemSource).
+//
+// Supported formats:
+//  * libsvm: `<label> <index>:<value> <index>:<value> ...` with 1-based increasing indexes
+//  * CSV (`.csv` extension): `<label>,<value>,<value>,...`, all rows having the
+//    same number of columns. A non-numeric first line is taken as a header and skipped.
+// Empty lines are ignored and zero features are not stored.
+//
+// The file is read twice: once to size the problem arena, once to fill it.
+// With `cache`, the parsed problem is saved next to the file and mapped back
+// by later builds as long as the file is unchanged (see dataset-cache.h).
+//
+class FileProblemSource : public ProblemSource {
+ public:
+  FileProblemSource(const char *path, bool cache = false) : path(path), cache(cache) {
+    message[0] = '\0';
+  }
+
+  struct svm_problem *build() {
+    if (cache) {
+      struct svm_problem *cached = loadDatasetCache(path.c_str(), &nbFeatures, nodeOwners);
+      if (cached != NULL)
+        return cached;
+    }
+    MappedFile file;
+    if (!file.open(path.c_str())) {
+      return fail(0, "cannot read dataset file");
+    }
+    const char *begin = file.data;
+    const char *end = file.data + file.size;
+    struct svm_problem *prob = isCsv() ? parseCsv(begin, end) : parseLibsvm(begin, end);
+    if (prob != NULL && cache)
+      writeDatasetCache(path.c_str(), prob, nbFeatures); // no cache is not an error
+    return prob;
+  }
+
+ private:
+  bool isCsv() {
+    size_t n = path.size();
+    return n >= 4 && path.compare(n - 4, 4, ".csv") == 0;
+  }
+
+  struct svm_problem *fail(int line, const char *reason) {
+    if (line > 0)
+      snprintf(message, sizeof(message), "%s (line %d of %s)", reason, line, path.c_str());
+    else
+      snprintf(message, sizeof(message), "%s (%s)", reason, path.c_str());
+    error = message;
+    return NULL;
+  }
+
+  static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  static inline const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p))
+      p++;
+    return p;
+  }
+
+  static inline const char *lineEnd(const char *p, const char *end) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    return eol == NULL ? end : eol;
+  }
+
+  static inline const char *nextLine(const char *eol, const char *end) {
+    return eol < end ? eol + 1 : end;
+  }
+
+  // Parse the number starting at p (the mapped file is not NUL terminated,
+  // so the token is copied first). Return its end, or NULL if it is not a
+  // finite number (strtod also accepts inf and nan).
+  static const char *parseNumber(const char *p, const char *end, double *value) {
+    char buffer[64];
+    size_t n = 0;
+    while (p + n < end && n < sizeof(buffer) && !isBlank(p[n]) &&
+           p[n] != ':' && p[n] != ',' && p[n] != '\n')
+      n++;
+    if (n == 0 || n == sizeof(buffer))
+      return NULL;
+    memcpy(buffer, p, n);
+    buffer[n] = '\0';
+    char *stop;
+    *value = strtod(buffer, &stop);
+    return stop == buffer + n && isfinite(*value) ? p + n : NULL;
+  }
+
+  // first pass: number of non-empty lines and number of `separator` in the file
+  static void count(const char *p, const char *end, char separator, int *nb_lines, size_t *nb_separators) {
+    *nb_lines = 0;
+    *nb_separators = 0;
+    while (p < end) {
+      const char *eol = lineEnd(p, end);
+      if (skipBlanks(p, eol) != eol)
+        (*nb_lines)++;
+      for (; p < eol; p++) {
+        if (*p == separator)
+          (*nb_separators)++;
+      }
+      p = nextLine(eol, end);
+    }
+  }
+
+  struct svm_problem *parseLibsvm(const char *begin, const char *end) {
+    int nb_rows;
+    size_t nb_values;
+    count(begin, end, ':', &nb_rows, &nb_values);
+    if (nb_rows == 0)
+      return fail(0, "dataset file is empty");
+
+    struct svm_problem *prob = allocSvmProblem(nb_rows, nb_values + nb_rows);
+    struct svm_node *x_space = getSvmProblemNodes(prob);
+    int max_index = 0;
+    int i = 0;
+    int line = 0;
+    for (const char *p = begin; p < end; ) {
+      const char *eol = lineEnd(p, end);
+      line++;
+      p = skipBlanks(p, eol);
+      if (p == eol) {
+        p = nextLine(eol, end);
+        continue;
+      }
+
+      p = parseNumber(p, eol, &prob->y[i]);
+      if (p == NULL)
+        return failWith(prob, line, "invalid label");
+      prob->x[i] = x_space;
+      int previous_index = 0;
+      for (p = skipBlanks(p, eol); p < eol; p = skipBlanks(p, eol)) {
+        double index, value;
+        p = parseNumber(p, eol, &index);
+        if (p == NULL || p == eol || *p != ':' || index != floor(index))
+          return failWith(prob, line, "invalid feature, expected <index>:<value>");
+        if (index <= previous_index)
+          return failWith(prob, line, "feature indexes must be positive and increasing");
+        if (index > INT_MAX)
+          return failWith(prob, line, "feature index out of range");
+        p = parseNumber(p + 1, eol, &value);
+        if (p == NULL)
+          return failWith(prob, line, "invalid feature value");
+        previous_index = (int)index;
+        if (value != 0) {
+          x_space->index = previous_index;
+          x_space->value = value;
+          x_space++;
+        }
+      }
+      if (previous_index > max_index)
+        max_index = previous_index;
+      (x_space++)->index = -1;
+      i++;
+      p = nextLine(eol, end);
+    }
+    nbFeatures = max_index;
+    return prob;
+  }
+
+  struct svm_problem *parseCsv(const char *begin, const char *end) {
+    // skip the header, if any
+    const char *p = begin;
+    int line = 0;
+    while (p < end) {
+      const char *eol = lineEnd(p, end);
+      const char *first = skipBlanks(p, eol);
+      if (first != eol) {
+        double label;
+        if (parseNumber(first, eol, &label) == NULL) {
+          p = nextLine(eol, end);
+          line++;
+        }
+        break;
+      }
+      p = nextLine(eol, end);
+      line++;
+    }
+
+    int nb_rows;
+    size_t nb_commas;
+    count(p, end, ',', &nb_rows, &nb_commas);
+    if (nb_rows == 0)
+      return fail(0, "dataset file is empty");
+
+    struct svm_problem *prob = allocSvmProblem(nb_rows, nb_commas + nb_rows);
+    struct svm_node *x_space = getSvmProblemNodes(prob);
+    int nb_columns = -1;
+    int i = 0;
+    while (p < end) {
+      const char *eol = lineEnd(p, end);
+      line++;
+      p = skipBlanks(p, eol);
+      if (p == eol) {
+        p = nextLine(eol, end);
+        continue;
+      }
+
+      p = parseNumber(p, eol, &prob->y[i]);
+      if (p == NULL)
+        return failWith(prob, line, "invalid label");
+      prob->x[i] = x_space;
+      int j = 0;
+      for (p = skipBlanks(p, eol); p < eol; p = skipBlanks(p, eol)) {
+        double value;
+        if (*p != ',')
+          return failWith(prob, line, "invalid value");
+        p = parseNumber(skipBlanks(p + 1, eol), eol, &value);
+        if (p == NULL)
+          return failWith(prob, line, "invalid value");
+        j++;
+        if (value != 0) {
+          x_space->index = j;
+          x_space->value = value;
+          x_space++;
+        }
+      }
+      if (nb_columns == -1)
+        nb_columns = j;
+      else if (nb_columns != j)
+        return failWith(prob, line, "all rows should have the same number of columns");
+      (x_space++)->index = -1;
+      i++;
+      p = nextLine(eol, end);
+    }
+    nbFeatures = nb_columns;
+    return prob;
+  }
+
+  struct svm_problem *failWith(struct svm_problem *prob, int line, const char *reason) {
+    freeSvmProblem(prob);
+    return fail(line, reason);
+  }
+
+  std::string path;
+  bool cache;
+  char message[512];
+};
+
+#endif /* _NODE_SVM_FILE_PROBLEM_SOURCE_H */
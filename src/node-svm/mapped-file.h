@@ -0,0 +1,79 @@
+#ifndef _NODE_SVM_MAPPED_FILE_H
+#define _NODE_SVM_MAPPED_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//
+// Read-only view of a whole file: memory mapped when possible so that large
+// datasets are paged in by the OS instead of being copied.
+//
+class MappedFile {
+ public:
+  MappedFile() : data(NULL), size(0), mapped(false) {}
+  ~MappedFile() {
+    if (data == NULL)
+      return;
+#ifndef _WIN32
+    if (mapped) {
+      munmap((void *)data, size);
+      return;
+    }
+#endif
+    free((void *)data);
+  }
+
+  // return false if the file can not be read or is empty.
+  // `sequential` tells the OS the file is read once from start to end.
+  bool open(const char *path, bool sequential = true) {
+#ifndef _WIN32
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return false;
+    }
+    size = st.st_size;
+    void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr != MAP_FAILED) {
+      madvise(addr, size, sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+      data = (const char *)addr;
+      mapped = true;
+      return true;
+    }
+#endif
+    // no mmap: read the whole file
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+      return false;
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    if (length <= 0) {
+      fclose(fp);
+      return false;
+    }
+    char *buffer = (char *)malloc(length);
+    fseek(fp, 0, SEEK_SET);
+    size = fread(buffer, 1, length, fp);
+    fclose(fp);
+    data = buffer;
+    return size == (size_t)length;
+  }
+
+  const char *data;
+  size_t size;
+
+ private:
+  bool mapped;
+};
+
+#endif /* _NODE_SVM_MAPPED_FILE_H */
@@ -1,8 +1,10 @@
 
 #include "node-svm.h"
+#include "dataset.h"
 #include "training-worker.h"
 #include "prediction-worker.h"
 #include "probability-prediction-worker.h"
+#include "file-prediction-worker.h"
 
 using v8::FunctionTemplate;
 using v8::Object;
@@ -12,7 +14,11 @@ using v8::Array;
 Nan::Persistent<Function> NodeSvm::constructor;
 
 NodeSvm::~NodeSvm(){
-
+    releaseModel();
+    if (trainingProblem != NULL){
+        freeSvmProblem(trainingProblem);
+    }
+    delete params;
 }
 
 NAN_METHOD(NodeSvm::New) {
@@ -44,21 +50,53 @@ NAN_METHOD(NodeSvm::SetParameters) {
 
     assert(info[0]->IsObject());
     Local<Object> params = info[0].As<Object>();
-    obj->setParameters(params);
+    const char *err = obj->setParameters(params);
+    if (err != NULL) {
+        info.GetReturnValue().Set(Nan::New<String>(err).ToLocalChecked());
+    }
+}
+
+// Build the training problem on the current thread and train.
+// Invalid data is reported as a JS exception.
+static void trainSync(NodeSvm *obj, ProblemSource *source) {
+    struct svm_problem *prob = source->build();
+    if (prob == NULL) {
+        Nan::ThrowError(source->error);
+    }
+    else {
+        obj->setTrainingProblem(prob, source->nbFeatures, source->nodeOwners, source->gram, source->gramSize, source->kernelStore);
+        obj->train();
+    }
+    delete source;
+}
+
+// expects (dataset[, subset]) where dataset is a Dataset and subset an Int32Array of row indexes
+static ProblemSource *newDatasetProblemSource(NodeSvm *obj, const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    Dataset *dataset = Nan::ObjectWrap::Unwrap<Dataset>(info[0].As<Object>());
+    if (info[1]->IsInt32Array()) {
+        Nan::TypedArrayContents<int32_t> subset(info[1]);
+        return dataset->newProblemSource(*subset, subset.length(), obj->getParameters(), obj->getKernelStoreSize());
+    }
+    return dataset->newProblemSource(NULL, dataset->size(), obj->getParameters(), obj->getKernelStoreSize());
 }
 
+// expects [[x0, y0], [x1, y1], ...] or (dataset[, subset]) (see newDatasetProblemSource)
 NAN_METHOD(NodeSvm::Train) {
     Nan::HandleScope scope;
     NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
 
     // check obj
     assert(obj->hasParameters());
+
+    if (Dataset::HasInstance(info[0])) {
+        trainSync(obj, newDatasetProblemSource(obj, info));
+        return;
+    }
     // chech params
-    assert(info[0]->IsObject());
+    assert(info[0]->IsArray());
 
     Local<Array> dataset = info[0].As<Array>();
-    obj->setSvmProblem(dataset);
-    obj->train();
+    trainSync(obj, new ArrayProblemSource(dataset));
 }
 
 NAN_METHOD(NodeSvm::GetModel) {
@@ -70,20 +108,136 @@ NAN_METHOD(NodeSvm::GetModel) {
     info.GetReturnValue().Set(obj->getModel());
 }
 
+NAN_METHOD(NodeSvm::GetTrainingStats) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+    info.GetReturnValue().Set(obj->getTrainingStats());
+}
+
+// same as Train, followed by a callback
 NAN_METHOD(NodeSvm::TrainAsync) {
     Nan::HandleScope scope;
     NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
 
     // check obj
     assert(obj->hasParameters());
+
+    if (Dataset::HasInstance(info[0])) {
+        int callback_index = info[1]->IsFunction() ? 1 : 2;
+        assert(info[callback_index]->IsFunction());
+        Nan::Callback *callback = new Nan::Callback(info[callback_index].As<Function>());
+        // rows are shared, not copied: nothing is left to do but train
+        Nan::AsyncQueueWorker(new TrainingWorker(obj, newDatasetProblemSource(obj, info), callback));
+        return;
+    }
     // chech params
-    assert(info[0]->IsObject());
+    assert(info[0]->IsArray());
     assert(info[1]->IsFunction());
 
     Local<Array> dataset = info[0].As<Array>();
     Nan::Callback *callback = new Nan::Callback(info[1].As<Function>());
 
-    Nan::AsyncQueueWorker(new TrainingWorker(obj, dataset, callback));
+    // the dataset is copied here, svm_node arrays are built by the worker
+    Nan::AsyncQueueWorker(new TrainingWorker(obj, new ArrayProblemSource(dataset), callback));
+}
+
+// Queue a training worker reading typed arrays info[0..nb_args), followed by
+// the callback: they are kept alive until the worker is done so it can read their memory
+static void queueTypedArrayTraining(NodeSvm *obj, ProblemSource *source, const Nan::FunctionCallbackInfo<v8::Value>& info, int nb_args = 4) {
+    static const char *keys[] = { "arg0", "arg1", "arg2", "arg3" };
+    assert(nb_args <= 4);
+    Nan::Callback *callback = new Nan::Callback(info[nb_args].As<Function>());
+    TrainingWorker *worker = new TrainingWorker(obj, source, callback);
+    for (int i = 0; i < nb_args; i++) {
+        worker->SaveToPersistent(keys[i], info[i]);
+    }
+    Nan::AsyncQueueWorker(worker);
+}
+
+NAN_METHOD(NodeSvm::TrainMatrix) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+
+    trainSync(obj, newMatrixProblemSource(info));
+}
+
+NAN_METHOD(NodeSvm::TrainMatrixAsync) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+    // chech params
+    assert(info[4]->IsFunction());
+
+    queueTypedArrayTraining(obj, newMatrixProblemSource(info), info);
+}
+
+NAN_METHOD(NodeSvm::TrainCsr) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+
+    trainSync(obj, newCsrProblemSource(info));
+}
+
+NAN_METHOD(NodeSvm::TrainCsrAsync) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+    // chech params
+    assert(info[4]->IsFunction());
+
+    queueTypedArrayTraining(obj, newCsrProblemSource(info), info);
+}
+
+// expects (gram, n, labels) (see newPrecomputedProblemSource)
+NAN_METHOD(NodeSvm::TrainPrecomputed) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+    assert(obj->getKernelType() == PRECOMPUTED);
+
+    trainSync(obj, newPrecomputedProblemSource(info));
+}
+
+NAN_METHOD(NodeSvm::TrainPrecomputedAsync) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+    assert(obj->getKernelType() == PRECOMPUTED);
+    // chech params
+    assert(info[3]->IsFunction());
+
+    queueTypedArrayTraining(obj, newPrecomputedProblemSource(info), info, 3);
+}
+
+// expects (path, callback): the dataset file is read and parsed by the worker
+NAN_METHOD(NodeSvm::TrainFromFileAsync) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->hasParameters());
+    // chech params
+    assert(info[0]->IsString());
+    assert(info[1]->IsFunction());
+
+    Nan::Utf8String path(info[0]);
+    Nan::Callback *callback = new Nan::Callback(info[1].As<Function>());
+
+    Nan::AsyncQueueWorker(new TrainingWorker(obj, new FileProblemSource(*path), callback));
 }
 
 NAN_METHOD(NodeSvm::GetKernelType) {
@@ -102,6 +256,12 @@ NAN_METHOD(NodeSvm::GetSvmType) {
     info.GetReturnValue().Set(Nan::New<Number>(obj->getSvmType()));
 }
 
+NAN_METHOD(NodeSvm::GetNbSupportVectors) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+    info.GetReturnValue().Set(Nan::New<Number>(obj->getNbSupportVectors()));
+}
+
 NAN_METHOD(NodeSvm::IsTrained) {
     Nan::HandleScope scope;
     NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
@@ -128,11 +288,15 @@ NAN_METHOD(NodeSvm::GetLabels) {
 NAN_METHOD(NodeSvm::SetModel) {
     Nan::HandleScope scope;
     NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
-    assert(info.Length() == 1);
+    assert(info.Length() == 1 || info.Length() == 2);
     assert(info[0]->IsObject());
 
     Local<Array> model = info[0].As<Array>();
-    obj->setModel(model);
+    // second argument false: RBF predictions compute ||x - sv||^2 without the stored ||sv||^2 (benchmarks)
+    const char *err = obj->setModel(model, info.Length() < 2 || info[1]->BooleanValue());
+    if (err != NULL) {
+        Nan::ThrowError(err);
+    }
 }
 
 NAN_METHOD(NodeSvm::Predict) {
@@ -154,6 +318,82 @@ NAN_METHOD(NodeSvm::Predict) {
     info.GetReturnValue().Set(Nan::New<Number>(prediction));
 }
 
+template <typename T>
+static Local<Array> predictCsr(NodeSvm *obj, const int32_t *indptr, int nb_rows, const int32_t *indices, const T *values) {
+    int max_nnz = 0;
+    for (int i = 0; i < nb_rows; i++) {
+        assert(indptr[i] <= indptr[i+1]);
+        if (indptr[i+1] - indptr[i] > max_nnz)
+            max_nnz = indptr[i+1] - indptr[i];
+    }
+    svm_node *x = new svm_node[max_nnz + 1];
+    Local<Array> predictions = Nan::New<Array>(nb_rows);
+    for (int i = 0; i < nb_rows; i++) {
+        svm_node *end = getCsrSvmNodes(indices, values, indptr[i], indptr[i+1], x);
+        assert(end != NULL); // column indices must be non-negative and sorted
+        end->index = -1;
+        predictions->Set(i, Nan::New<Number>(obj->predict(x)));
+    }
+    delete[] x;
+    return predictions;
+}
+
+// expects (indptr, indices, values) (see newCsrProblemSource), returns one prediction per row
+NAN_METHOD(NodeSvm::PredictCsr) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->isTrained());
+    // chech params
+    assert(info[0]->IsInt32Array());
+    assert(info[1]->IsInt32Array());
+    Nan::TypedArrayContents<int32_t> indptr(info[0]);
+    Nan::TypedArrayContents<int32_t> indices(info[1]);
+    int nb_rows = indptr.length() - 1;
+    assert(nb_rows > 0);
+    assert((*indptr)[0] == 0);
+    assert((size_t)(*indptr)[nb_rows] == indices.length());
+
+    if (info[2]->IsFloat64Array()) {
+        Nan::TypedArrayContents<double> values(info[2]);
+        assert(values.length() == indices.length());
+        info.GetReturnValue().Set(predictCsr(obj, *indptr, nb_rows, *indices, *values));
+    }
+    else {
+        assert(info[2]->IsFloat32Array());
+        Nan::TypedArrayContents<float> values(info[2]);
+        assert(values.length() == indices.length());
+        info.GetReturnValue().Set(predictCsr(obj, *indptr, nb_rows, *indices, *values));
+    }
+}
+
+// expects (kernelValues, nbRows) where kernelValues is a nbRows x nbSupportVectors
+// row-major Float64Array: K(x_i, SV_j) for every test sample x_i and every SV of the
+// model (in model order, see getModel). Returns one prediction per row
+NAN_METHOD(NodeSvm::PredictPrecomputed) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->isTrained());
+    assert(obj->getKernelType() == PRECOMPUTED);
+    // chech params
+    assert(info[0]->IsFloat64Array());
+    assert(info[1]->IsInt32());
+    int nb_rows = info[1]->IntegerValue();
+    int nb_sv = obj->getNbSupportVectors();
+    assert(nb_rows > 0);
+    Nan::TypedArrayContents<double> kvalues(info[0]);
+    assert(kvalues.length() == (size_t)nb_rows * nb_sv);
+
+    Local<Array> predictions = Nan::New<Array>(nb_rows);
+    for (int i = 0; i < nb_rows; i++) {
+        predictions->Set(i, Nan::New<Number>(obj->predictPrecomputed(*kvalues + (size_t)i * nb_sv)));
+    }
+    info.GetReturnValue().Set(predictions);
+}
+
 NAN_METHOD(NodeSvm::PredictAsync) {
     Nan::HandleScope scope;
     NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
@@ -172,6 +412,23 @@ NAN_METHOD(NodeSvm::PredictAsync) {
 }
 
 
+// expects (path, callback), callback receives (err, predictions, expected labels)
+NAN_METHOD(NodeSvm::PredictFileAsync) {
+    Nan::HandleScope scope;
+    NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
+
+    // check obj
+    assert(obj->isTrained());
+    // chech params
+    assert(info[0]->IsString());
+    assert(info[1]->IsFunction());
+
+    Nan::Utf8String path(info[0]);
+    Nan::Callback *callback = new Nan::Callback(info[1].As<Function>());
+
+    Nan::AsyncQueueWorker(new FilePredictionWorker(obj, *path, callback));
+}
+
 NAN_METHOD(NodeSvm::PredictProbabilities) {
     Nan::HandleScope scope;
     NodeSvm *obj = Nan::ObjectWrap::Unwrap<NodeSvm>(info.This());
@@ -235,6 +492,27 @@ void NodeSvm::Init(Local<Object> exports){
     tpl->PrototypeTemplate()->Set(Nan::New<String>("trainAsync").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::TrainAsync));
 
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainMatrix").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainMatrix));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainMatrixAsync").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainMatrixAsync));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainCsr").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainCsr));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainCsrAsync").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainCsrAsync));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainFromFileAsync").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainFromFileAsync));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainPrecomputed").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainPrecomputed));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("trainPrecomputedAsync").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::TrainPrecomputedAsync));
+
     tpl->PrototypeTemplate()->Set(Nan::New<String>("isTrained").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::IsTrained));
 
@@ -247,12 +525,24 @@ void NodeSvm::Init(Local<Object> exports){
     tpl->PrototypeTemplate()->Set(Nan::New<String>("getKernelType").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::GetKernelType));
 
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("getNbSupportVectors").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::GetNbSupportVectors));
+
     tpl->PrototypeTemplate()->Set(Nan::New<String>("predict").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::Predict));
 
     tpl->PrototypeTemplate()->Set(Nan::New<String>("predictAsync").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::PredictAsync));
 
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("predictCsr").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::PredictCsr));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("predictPrecomputed").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::PredictPrecomputed));
+
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("predictFileAsync").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::PredictFileAsync));
+
     tpl->PrototypeTemplate()->Set(Nan::New<String>("predictProbabilities").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::PredictProbabilities));
 
@@ -265,6 +555,9 @@ void NodeSvm::Init(Local<Object> exports){
     tpl->PrototypeTemplate()->Set(Nan::New<String>("getModel").ToLocalChecked(),
     Nan::New<FunctionTemplate>(NodeSvm::GetModel));
 
+    tpl->PrototypeTemplate()->Set(Nan::New<String>("getTrainingStats").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(NodeSvm::GetTrainingStats));
+
     //constructor = Persistent<Function>::New(tpl->GetFunction());
     exports->Set(Nan::New<String>("NodeSvm").ToLocalChecked(), tpl->GetFunction());
     constructor.Reset(Nan::GetFunction(tpl).ToLocalChecked());
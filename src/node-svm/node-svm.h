@@ -5,10 +5,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include <node.h>
 #include <assert.h>
 #include <nan.h>
+#include <uv.h>
 #include "../libsvm/svm.h"
+#include "svm-problem.h"
+#include "problem-source.h"
 
 
 
@@ -21,20 +26,36 @@ class NodeSvm : public Nan::ObjectWrap
         static NAN_METHOD(SetParameters);
         static NAN_METHOD(Train);
         static NAN_METHOD(TrainAsync);
+        static NAN_METHOD(TrainMatrix);
+        static NAN_METHOD(TrainMatrixAsync);
+        static NAN_METHOD(TrainCsr);
+        static NAN_METHOD(TrainCsrAsync);
+        static NAN_METHOD(TrainFromFileAsync);
+        static NAN_METHOD(TrainPrecomputed);
+        static NAN_METHOD(TrainPrecomputedAsync);
         static NAN_METHOD(IsTrained);
         static NAN_METHOD(GetLabels);
         static NAN_METHOD(GetKernelType);
         static NAN_METHOD(GetSvmType);
+        static NAN_METHOD(GetNbSupportVectors);
         static NAN_METHOD(Predict);
         static NAN_METHOD(PredictAsync);
+        static NAN_METHOD(PredictCsr);
+        static NAN_METHOD(PredictPrecomputed);
+        static NAN_METHOD(PredictFileAsync);
         static NAN_METHOD(PredictProbabilities);
         static NAN_METHOD(PredictProbabilitiesAsync);
         static NAN_METHOD(SaveToFile);
         static NAN_METHOD(LoadFromFile);
         static NAN_METHOD(SetModel);
         static NAN_METHOD(GetModel);
+        static NAN_METHOD(GetTrainingStats);
         static NAN_METHOD(New);
 
+        NodeSvm() : params(NULL), model(NULL), trainingProblem(NULL), trainingGram(NULL), trainingGramSize(0), nbFeatures(0), kernelStoreSize(0), autoCacheSize(false) {
+            memset(&trainingStats, 0, sizeof(trainingStats));
+        }
+
         bool isTrained(){ return model != NULL;}
 
         bool hasParameters(){ return params != NULL;}
@@ -55,6 +76,9 @@ class NodeSvm : public Nan::ObjectWrap
         bool isRegressionSVM(){ return !isClassificationSVM();};
         int getSvmType(){ return params->svm_type; };
         int getKernelType(){ return params->kernel_type; };
+        const struct svm_parameter *getParameters(){ return params; };
+        // MB of kernel columns shared by the trainings on a Dataset (see Dataset::getKernelStore)
+        double getKernelStoreSize(){ return kernelStoreSize; };
         int getClassNumber(){
             if(model==NULL){
                 return 0;
@@ -69,18 +93,27 @@ class NodeSvm : public Nan::ObjectWrap
         };
 
         void loadModelFromFile(const char *fileName){
+            releaseModel();
             model = svm_load_model(fileName);
             assert(model!=NULL);
-            params = &model->param;
-            assert(params!=NULL);
+            delete params;
+            params = new svm_parameter(model->param);
         };
 
-        void setParameters(Local<Object> obj){
+        // Returns NULL, or an error message for a bad cacheSize (other options are asserted)
+        const char *setParameters(Local<Object> obj){
             struct svm_parameter *svm_params = new svm_parameter();
 
             svm_params->nr_weight = 0;
             svm_params->weight_label = NULL;
             svm_params->weight = NULL;
+            svm_params->gram = NULL;
+            svm_params->gram_n = 0;
+            svm_params->fast_math = 0;
+            svm_params->stats = NULL;
+            svm_params->approximation = NO_APPROXIMATION;
+            svm_params->approx_rank = 0;
+            svm_params->approx_seed = 0;
 
             // check  classifer and its options
             Local<String> svm_type_name = Nan::New<String>("svmType").ToLocalChecked();
@@ -126,7 +159,7 @@ class NodeSvm : public Nan::ObjectWrap
             assert(svm_params->kernel_type == LINEAR ||
                    svm_params->kernel_type == POLY ||
                    svm_params->kernel_type == RBF ||
-                   // svm_params->kernel_type == PRECOMPUTED ||  // not supported (yet)
+                   svm_params->kernel_type == PRECOMPUTED ||  // see TrainPrecomputed
                    svm_params->kernel_type == SIGMOID);
 
             if (svm_params->kernel_type == POLY){
@@ -155,13 +188,51 @@ class NodeSvm : public Nan::ObjectWrap
                 assert(Nan::Has(obj, str_r).FromJust());
                 svm_params->coef0 = Nan::Get(obj, str_r).ToLocalChecked()->NumberValue();
             }
+            if (svm_params->kernel_type == RBF ||
+                svm_params->kernel_type == SIGMOID){
+
+                Local<String> str_fast_kernel_math = Nan::New<String>("fastKernelMath").ToLocalChecked();
+                svm_params->fast_math =  // disabled by default
+                    Nan::Has(obj, str_fast_kernel_math).FromJust() &&
+                    Nan::Get(obj, str_fast_kernel_math).ToLocalChecked()->BooleanValue() ? 1 : 0;
+            }
+
+            // approximate kernel feature map (see svm_train_approximate)
+            Local<String> str_approximation = Nan::New<String>("approximation").ToLocalChecked();
+            if (Nan::Has(obj, str_approximation).FromJust()){
+                svm_params->approximation = Nan::Get(obj, str_approximation).ToLocalChecked()->IntegerValue();
+                assert(svm_params->approximation == NO_APPROXIMATION ||
+                       svm_params->approximation == NYSTROEM ||
+                       svm_params->approximation == RANDOM_FOURIER);
+            }
+            if (svm_params->approximation != NO_APPROXIMATION){
+                assert(svm_params->kernel_type != PRECOMPUTED);
+                assert(svm_params->approximation != RANDOM_FOURIER || svm_params->kernel_type == RBF);
+
+                Local<String> str_approximation_rank = Nan::New<String>("approximationRank").ToLocalChecked();
+                svm_params->approx_rank = Nan::Has(obj, str_approximation_rank).FromJust() ?
+                    Nan::Get(obj, str_approximation_rank).ToLocalChecked()->IntegerValue() :
+                    100;
+                assert(svm_params->approx_rank > 0);
+
+                Local<String> str_approximation_seed = Nan::New<String>("approximationSeed").ToLocalChecked();
+                svm_params->approx_seed = Nan::Has(obj, str_approximation_seed).FromJust() ?
+                    Nan::Get(obj, str_approximation_seed).ToLocalChecked()->IntegerValue() :
+                    0;
+            }
 
             // check training options
             Local<String> str_cache_size = Nan::New<String>("cacheSize").ToLocalChecked();
-            svm_params->cache_size = Nan::Has(obj, str_cache_size).FromJust() ?
-                Nan::Get(obj, str_cache_size).ToLocalChecked()->NumberValue() :
-                100;
-            assert(svm_params->cache_size > 0);
+            Local<Value> cache_size = Nan::Has(obj, str_cache_size).FromJust() ?
+                Nan::Get(obj, str_cache_size).ToLocalChecked() :
+                Nan::New<Number>(100).As<Value>();
+            bool auto_cache_size = cache_size->IsString() && strcmp(*Nan::Utf8String(cache_size), "auto") == 0;
+            svm_params->cache_size = auto_cache_size ? 0 : cache_size->NumberValue(); // 'auto': resolved by train
+            if (!auto_cache_size && !(cache_size->IsNumber() && svm_params->cache_size > 0)){
+                delete svm_params;
+                return "cacheSize must be a positive number of MB or 'auto'";
+            }
+            autoCacheSize = auto_cache_size;
 
             Local<String> str_eps = Nan::New<String>("eps").ToLocalChecked();
             svm_params->eps = Nan::Has(obj, str_eps).FromJust() ?
@@ -180,22 +251,65 @@ class NodeSvm : public Nan::ObjectWrap
                 Nan::Has(obj, str_probability).FromJust() &&
                 Nan::Get(obj, str_probability).ToLocalChecked()->BooleanValue() ? 1 : 0;
 
+            Local<String> str_threads = Nan::New<String>("threads").ToLocalChecked();
+            svm_params->threads = Nan::Has(obj, str_threads).FromJust() ?
+                Nan::Get(obj, str_threads).ToLocalChecked()->IntegerValue() :
+                1;
+            assert(svm_params->threads > 0);
+
+            Local<String> str_half_precision_cache = Nan::New<String>("halfPrecisionCache").ToLocalChecked();
+            svm_params->half_cache =  // disabled by default
+                Nan::Has(obj, str_half_precision_cache).FromJust() &&
+                Nan::Get(obj, str_half_precision_cache).ToLocalChecked()->BooleanValue() ? 1 : 0;
+
+            Local<String> str_cache_policy = Nan::New<String>("cachePolicy").ToLocalChecked();
+            svm_params->cache_policy = Nan::Has(obj, str_cache_policy).FromJust() ?
+                Nan::Get(obj, str_cache_policy).ToLocalChecked()->IntegerValue() :
+                LRU_CACHE;
+            assert(svm_params->cache_policy == LRU_CACHE ||
+                   svm_params->cache_policy == SHRINKING_CACHE);
+
+            Local<String> str_share_kernel = Nan::New<String>("shareKernel").ToLocalChecked();
+            svm_params->share_kernel =  // enabled by default
+                Nan::Has(obj, str_share_kernel).FromJust() &&
+                !Nan::Get(obj, str_share_kernel).ToLocalChecked()->BooleanValue() ? 0 : 1;
+
+            Local<String> str_kernel_store_size = Nan::New<String>("kernelStoreSize").ToLocalChecked();
+            kernelStoreSize = Nan::Has(obj, str_kernel_store_size).FromJust() ?  // disabled by default
+                Nan::Get(obj, str_kernel_store_size).ToLocalChecked()->NumberValue() :
+                0;
+            assert(kernelStoreSize >= 0);
+
             if (svm_params->svm_type == ONE_CLASS){
                 assert(svm_params->probability == 0); // one-class SVM probability output not supported (yet)
             }
+            if (svm_params->kernel_type == PRECOMPUTED && svm_params->probability){
+                // trained from a gram matrix only, whose rows libsvm probability estimates can not read
+                delete svm_params;
+                return "probability estimates are not supported for precomputed kernels";
+            }
 
+            delete params;
             params = svm_params;
+            return NULL;
         };
 
-        void setModel(Local<Object> obj){
+        // returns an error message (the current model is kept), NULL if the model is loaded
+        const char *setModel(Local<Object> obj, bool sv_square = true){
             Local<String> str_params = Nan::New<String>("params").ToLocalChecked();
 
             assert(Nan::Has(obj, str_params).FromJust());
             assert(Nan::Get(obj, str_params).ToLocalChecked()->IsObject());
 
-            setParameters(Nan::Get(obj, str_params).ToLocalChecked()->ToObject());
+            const char *err = setParameters(Nan::Get(obj, str_params).ToLocalChecked()->ToObject());
+            if (err != NULL){
+                return err;
+            }
             assert(params!=NULL);
-            struct svm_model *new_model = new svm_model();
+            releaseModel();
+
+            // allocated the way svm_load_model does so that svm_free_and_destroy_model can release it
+            struct svm_model *new_model = (struct svm_model *)malloc(sizeof(struct svm_model));
 
             new_model->free_sv = 1;   // XXX
             new_model->rho = NULL;
@@ -204,6 +318,11 @@ class NodeSvm : public Nan::ObjectWrap
             new_model->sv_indices = NULL;
             new_model->label = NULL;
             new_model->nSV = NULL;
+            new_model->sv_square = NULL;
+            new_model->rank = 0;
+            new_model->basis = NULL;
+            new_model->phase = NULL;
+            new_model->w = NULL;
 
             Local<String> str_l = Nan::New<String>("l").ToLocalChecked();
 
@@ -223,7 +342,7 @@ class NodeSvm : public Nan::ObjectWrap
             assert(Nan::Get(obj, str_rho).ToLocalChecked()->IsArray());
             Local<Array> rho = Nan::Get(obj, str_rho).ToLocalChecked().As<Array>();
             assert(rho->Length()==n);
-            new_model->rho = new double[n];
+            new_model->rho = (double *)malloc(n * sizeof(double));
             for(unsigned int i=0;i<n;i++){
                 Local<Value> elt = rho->Get(i);
                 assert(elt->IsNumber());
@@ -236,7 +355,7 @@ class NodeSvm : public Nan::ObjectWrap
                 assert(Nan::Get(obj, str_labels).ToLocalChecked()->IsArray());
                 Local<Array> labels = Nan::Get(obj, str_labels).ToLocalChecked().As<Array>();
                 //assert(labels->Length()==new_model->nr_class);
-                new_model->label = new int[new_model->nr_class];
+                new_model->label = (int *)malloc(new_model->nr_class * sizeof(int));
                 for(int i=0;i<new_model->nr_class;i++){
                     Local<Value> elt = labels->Get(i);
                     assert(elt->IsInt32());
@@ -249,7 +368,7 @@ class NodeSvm : public Nan::ObjectWrap
                 assert(Nan::Get(obj, str_nb_support_vectors).ToLocalChecked()->IsArray());
                 Local<Array> nbSupportVectors = Nan::Get(obj, str_nb_support_vectors).ToLocalChecked().As<Array>();
                 assert((int)nbSupportVectors->Length() == new_model->nr_class);
-                new_model->nSV = new int[new_model->nr_class];
+                new_model->nSV = (int *)malloc(new_model->nr_class * sizeof(int));
                 for (int i=0;i<new_model->nr_class;i++){
                     Local<Value> elt = nbSupportVectors->Get(i);
                     assert(elt->IsInt32());
@@ -263,7 +382,7 @@ class NodeSvm : public Nan::ObjectWrap
                 assert(Nan::Get(obj, str_prob_a).ToLocalChecked()->IsArray());
                 Local<Array> probA = Nan::Get(obj, str_prob_a).ToLocalChecked().As<Array>();
                 assert(probA->Length()==n);
-                new_model->probA = new double[n];
+                new_model->probA = (double *)malloc(n * sizeof(double));
                 for(unsigned int i=0;i<n;i++){
                     Local<Value> elt = probA->Get(i);
                     assert(elt->IsNumber());
@@ -277,7 +396,7 @@ class NodeSvm : public Nan::ObjectWrap
                 assert(Nan::Get(obj, str_prob_b).ToLocalChecked()->IsArray());
                 Local<Array> probB = Nan::Get(obj, str_prob_b).ToLocalChecked().As<Array>();
                 assert(probB->Length()==n);
-                new_model->probB = new double[n];
+                new_model->probB = (double *)malloc(n * sizeof(double));
                 for(unsigned int i=0;i<n;i++){
                     Local<Value> elt = probB->Get(i);
                     assert(elt->IsNumber());
@@ -296,103 +415,219 @@ class NodeSvm : public Nan::ObjectWrap
             assert((int)supportVectors->Length() == new_model->l);
             int m = new_model->nr_class - 1;
             int l = new_model->l;
-            new_model->sv_coef = new double *[m];
+            new_model->sv_coef = (double **)malloc(m * sizeof(double *));
             for(int i=0; i < m ;i++)
-                new_model->sv_coef[i] = new double[l];
+                new_model->sv_coef[i] = (double *)malloc(l * sizeof(double));
 
-            new_model->SV = new svm_node*[l];
+            // all SVs share one node space (released through SV[0])
+            size_t nb_nodes = 0;
+            nbFeatures = 0;
             for(int i = 0; i < l; i++) {
                 Local<Array> ex = supportVectors->Get(i).As<Array>();
                 assert(ex->Length()==2);
+                int nb_inputs = ex->Get(0).As<Array>()->Length();
+                nb_nodes += nb_inputs + 1;
+                if (nb_inputs > nbFeatures)
+                    nbFeatures = nb_inputs;
+            }
+            new_model->SV = (svm_node **)malloc(l * sizeof(svm_node *));
+            svm_node *x_space = l > 0 ? (svm_node *)malloc(nb_nodes * sizeof(svm_node)) : NULL;
+
+            for(int i = 0; i < l; i++) {
+                Local<Array> ex = supportVectors->Get(i).As<Array>();
                 Local<Array> x = ex->Get(0).As<Array>();
                 Local<Array> y = ex->Get(1).As<Array>();
 
-                new_model->SV[i] = new svm_node[x->Length() + 1];
-                for(unsigned j = 0; j < x->Length(); ++j) {
-                    new_model->SV[i][j].index = j+1;
-                    new_model->SV[i][j].value = x->Get(j)->NumberValue();
+                new_model->SV[i] = x_space;
+                if (params->kernel_type == PRECOMPUTED) {
+                    getPrecomputedSvmNodes(x, x_space);
                 }
-                new_model->SV[i][x->Length()].index = -1;
+                else {
+                    getSvmNodes(x, x_space);
+                }
+                while ((x_space++)->index != -1);
 
                 for(int j=0; j < m ;j++)
                     new_model->sv_coef[j][i] = y->Get(j)->NumberValue();
             }
 
+            // approximate models: feature map and weights (see svm_model.basis)
+            Local<String> str_weights = Nan::New<String>("weights").ToLocalChecked();
+            if (Nan::Has(obj, str_weights).FromJust()){
+                assert(params->approximation != NO_APPROXIMATION);
+                Local<String> str_basis = Nan::New<String>("basis").ToLocalChecked();
+                assert(Nan::Has(obj, str_basis).FromJust());
+                assert(Nan::Get(obj, str_basis).ToLocalChecked()->IsArray());
+                Local<Array> basis = Nan::Get(obj, str_basis).ToLocalChecked().As<Array>();
+                int rank = basis->Length();
+                assert(rank > 0);
+
+                // one node space, released through basis[0]
+                size_t nb_basis_nodes = 0;
+                for (int i = 0; i < rank; i++) {
+                    assert(basis->Get(i)->IsArray());
+                    int nb_inputs = basis->Get(i).As<Array>()->Length();
+                    nb_basis_nodes += nb_inputs + 1;
+                    if (nb_inputs > nbFeatures)
+                        nbFeatures = nb_inputs;
+                }
+                new_model->rank = rank;
+                new_model->basis = (svm_node **)malloc(rank * sizeof(svm_node *));
+                svm_node *basis_space = (svm_node *)malloc(nb_basis_nodes * sizeof(svm_node));
+                for (int i = 0; i < rank; i++) {
+                    new_model->basis[i] = basis_space;
+                    getSvmNodes(basis->Get(i).As<Array>(), basis_space);
+                    while ((basis_space++)->index != -1);
+                }
+
+                Local<String> str_phase = Nan::New<String>("phase").ToLocalChecked();
+                if (params->approximation == RANDOM_FOURIER){
+                    assert(Nan::Has(obj, str_phase).FromJust());
+                    assert(Nan::Get(obj, str_phase).ToLocalChecked()->IsArray());
+                    Local<Array> phase = Nan::Get(obj, str_phase).ToLocalChecked().As<Array>();
+                    assert((int)phase->Length() == rank);
+                    new_model->phase = (double *)malloc(rank * sizeof(double));
+                    for (int i = 0; i < rank; i++)
+                        new_model->phase[i] = phase->Get(i)->NumberValue();
+                }
+
+                assert(Nan::Get(obj, str_weights).ToLocalChecked()->IsArray());
+                Local<Array> weights = Nan::Get(obj, str_weights).ToLocalChecked().As<Array>();
+                assert(weights->Length() == n);
+                new_model->w = (double **)malloc(n * sizeof(double *));
+                for (unsigned int k = 0; k < n; k++) {
+                    assert(weights->Get(k)->IsArray());
+                    Local<Array> w = weights->Get(k).As<Array>();
+                    assert((int)w->Length() == rank);
+                    new_model->w[k] = (double *)malloc(rank * sizeof(double));
+                    for (int i = 0; i < rank; i++)
+                        new_model->w[k][i] = w->Get(i)->NumberValue();
+                }
+            }
+
 
             model = new_model;
             model->param = *params;
             assert(model!=NULL);
+            if (sv_square)
+                svm_model_init_sv_square(model);
+            return NULL;
         };
 
-        void setSvmProblem(Local<Array> dataset){
-            Nan::HandleScope scope;
-            struct svm_problem *prob = new svm_problem();
-            prob->l = 0;
-
-            assert(dataset->Length() > 0);
-
-            // check data structure and assign Y
-            prob->l= dataset->Length();
-            prob->y = new double[prob->l];
-            int nb_features = -1;
-            for (unsigned i=0; i < dataset->Length(); i++) {
-                Local<Value> t = dataset->Get(i);
-                assert(t->IsArray());
-                Local<Array> ex = t.As<Array>();
-                assert(ex->Length() == 2);
-
-                Local<Value> tin = ex->Get(0);
-                Local<Value> tout = ex->Get(1);
-                assert(tin->IsArray());
-                assert(tout->IsNumber());
-
-                Local<Array> x = tin.As<Array>();
-                if (nb_features == -1){
-                    nb_features = x->Length();
-                }
-                else {
-                    assert(nb_features == (int)x->Length()); // Incorrect dataset: all Xies should have the same length)
-                }
+        // Replace the training problem, releasing the previous one.
+        // Trained model's SVs point into the problem (or into node_owners,
+        // see ProblemSource) so the model goes first.
+        // gram is the kernel matrix of precomputed kernel problems: it is only
+        // read by train() and must be kept alive until then.
+        void setTrainingProblem(struct svm_problem *prob, int nb_features, const std::vector<SharedSvmProblem> &node_owners,
+                                const double *gram = NULL, int gram_size = 0,
+                                const SharedKernelStore &kernel_store = SharedKernelStore()){
+            releaseModel();
+            if (trainingProblem != NULL){
+                freeSvmProblem(trainingProblem);
             }
+            trainingProblem = prob;
+            trainingNodeOwners = node_owners;
+            trainingGram = gram;
+            trainingGramSize = gram_size;
+            trainingKernelStore = kernel_store;
+            nbFeatures = nb_features;
+        };
 
-            // Asign X and Y
-            prob->x = new svm_node*[dataset->Length()];
-            for (unsigned i = 0; i < dataset->Length(); i++) {
-                prob->x[i] = new svm_node[nb_features + 1];
-                Local<Array> ex = dataset->Get(i).As<Array>();
-                Local<Array> x = ex->Get(0).As<Array>();
-                for (unsigned j = 0; j < x->Length(); ++j) {
-                    double xi = x->Get(j)->NumberValue();
-                    prob->x[i][j].index = j+1;
-                    prob->x[i][j].value = xi;
-                }
-                prob->x[i][x->Length()].index = -1;
+        void releaseModel(){
+            svm_free_and_destroy_model(&model);
+        };
 
-                double y = ex->Get(1)->NumberValue();
-                prob->y[i] = y;
-            }
-            trainingProblem = prob;
+        // Cache size (MB) of `cacheSize: 'auto'`: the whole kernel matrix of the l training samples,
+        // within half the free memory shared by the trainings that may run at the same time on the
+        // libuv thread pool (see UV_THREADPOOL_SIZE), and at least 100MB of it.
+        double resolveAutoCacheSize(int l){
+            const char *pool_size = getenv("UV_THREADPOOL_SIZE");
+            int concurrency = pool_size != NULL && atoi(pool_size) > 0 ? atoi(pool_size) : 4;
+            double budget = std::max(100.0, (double)uv_get_free_memory() / 2 / concurrency / (1 << 20));
+            return std::min(svm_kernel_cache_size(l, params), budget);
         };
 
         void train(){
-            model = svm_train(trainingProblem, params);
+            // precomputed kernels are only trained from a kernel matrix
+            assert((params->kernel_type == PRECOMPUTED) == (trainingGram != NULL));
+            releaseModel();
+            struct svm_parameter training_params = *params;
+            training_params.gram = trainingGram;
+            training_params.gram_n = trainingGramSize;
+            memset(&trainingStats, 0, sizeof(trainingStats));
+            training_params.stats = &trainingStats;
+            training_params.kernel_store = trainingKernelStore.get();
+            if (autoCacheSize)
+                training_params.cache_size = resolveAutoCacheSize(trainingProblem->l);
+            model = svm_train(trainingProblem, &training_params);
+            trainingGram = NULL; // not needed anymore
+            trainingKernelStore.reset();
         };
 
+        // precomputed kernel models predict from kernel values only (see predictPrecomputed)
         double predict(svm_node *x){
+            assert(params->kernel_type != PRECOMPUTED);
             return svm_predict(model, x);
         }
 
         void predictProbabilities(svm_node *x, double* prob_estimates){
+            assert(params->kernel_type != PRECOMPUTED);
             svm_predict_probability(model,x,prob_estimates);
         };
 
+        // kvalue[i] = K(x, SV[i]) for the model->l SVs (precomputed kernels)
+        double predictPrecomputed(const double *kvalue){
+            return svm_predict_kernel(model, kvalue);
+        };
+
+        int getNbSupportVectors(){ return model==NULL ? 0 : model->l; };
+
+        // nodes must have room for inputs->Length() + 1 elements. Zero features are skipped
         void getSvmNodes(Local<Array> inputs, svm_node *nodes){
             for (unsigned j=0; j < inputs->Length(); j++){
                 double xi = inputs->Get(j)->NumberValue();
-                nodes[j].index = j+1;
-                nodes[j].value = xi;
+                if (xi != 0) {
+                    nodes->index = j+1;
+                    nodes->value = xi;
+                    nodes++;
+                }
+            }
+            nodes->index = -1;
+        };
+
+        // x as a dense array: zeros are not stored, pad up to the number of features
+        Local<Array> getDenseInputs(const svm_node *x){
+            const svm_node *p = x;
+            int max_index = nbFeatures;
+            while(p->index != -1){
+                if (p->index > max_index)
+                    max_index = p->index;
+
+                p++;
+            }
+
+            Local<Array> inputs = Nan::New<Array>(max_index);
+            int p_i = 0;
+            for (int k=0; k < max_index ; k++){
+                if (k+1 == x[p_i].index){
+                    inputs->Set(k, Nan::New<Number>(x[p_i].value));
+                    p_i++;
+                }
+                else {
+                    inputs->Set(k, Nan::New<Number>(0));
+                }
             }
-            nodes[inputs->Length()].index = -1;
+            return inputs;
+        };
+
+        // Precomputed kernel SV: [sample index] (0-based, see getModel)
+        void getPrecomputedSvmNodes(Local<Array> inputs, svm_node *nodes){
+            assert(inputs->Length() == 1);
+            nodes->index = 0;
+            nodes->value = inputs->Get(0)->NumberValue() + 1;
+            nodes++;
+            nodes->index = -1;
         };
 
         Local<Object> getModel(){
@@ -412,37 +647,51 @@ class NodeSvm : public Nan::ObjectWrap
                 for (int j=0; j < nb_outputs ; j++)
                     outputs->Set(j, Nan::New<Number>(sv_coef[j][i]));
 
-                const svm_node *p = SV[i];
-
-                int max_index = 0;
-                int nb_index = 0;
-                while(p->index != -1){
-                    nb_index++;
-                    if (p->index > max_index)
-                        max_index = p->index;
-
-                    p++;
-                }
-
-                Local<Array> inputs = Nan::New<Array>(nb_index);
-                int p_i = 0;
-                for (int k=0; k < max_index ; k++){
-                    if (k+1 == model->SV[i][p_i].index){
-                        inputs->Set(k, Nan::New<Number>(SV[i][p_i].value));
-                        p_i++;
-                    }
-                    else {
-                        inputs->Set(k, Nan::New<Number>(0));
-                    }
-                }
                 Local<Array> example = Nan::New<Array>(2);
-                example->Set(0, inputs);
                 example->Set(1, outputs);
                 supportVectors->Set(i, example);
+
+                if (model->param.kernel_type == PRECOMPUTED){
+                    // the SV is the training sample it was built from: report its index
+                    Local<Array> inputs = Nan::New<Array>(1);
+                    inputs->Set(0, Nan::New<Number>(SV[i][0].value - 1));
+                    example->Set(0, inputs);
+                    continue;
+                }
+
+                example->Set(0, getDenseInputs(SV[i]));
             }
             Local<String> str_support_vectors = Nan::New<String>("supportVectors").ToLocalChecked();
             obj->Set(str_support_vectors, supportVectors);
 
+            // approximate models: feature map and weights (see svm_model.basis)
+            if (model->w) {
+                Local<Array> basis = Nan::New<Array>(model->rank);
+                for (int i = 0; i < model->rank; i++)
+                    basis->Set(i, getDenseInputs(model->basis[i]));
+                Local<String> str_basis = Nan::New<String>("basis").ToLocalChecked();
+                obj->Set(str_basis, basis);
+
+                if (model->phase) {
+                    Local<Array> phase = Nan::New<Array>(model->rank);
+                    for (int i = 0; i < model->rank; i++)
+                        phase->Set(i, Nan::New<Number>(model->phase[i]));
+                    Local<String> str_phase = Nan::New<String>("phase").ToLocalChecked();
+                    obj->Set(str_phase, phase);
+                }
+
+                int n = model->nr_class*(model->nr_class-1)/2;
+                Local<Array> weights = Nan::New<Array>(n);
+                for (int k = 0; k < n; k++) {
+                    Local<Array> w = Nan::New<Array>(model->rank);
+                    for (int i = 0; i < model->rank; i++)
+                        w->Set(i, Nan::New<Number>(model->w[k][i]));
+                    weights->Set(k, w);
+                }
+                Local<String> str_weights = Nan::New<String>("weights").ToLocalChecked();
+                obj->Set(str_weights, weights);
+            }
+
             if (model->nSV) {
                 Local<Array> nbSupportVectors = Nan::New<Array>(model->nr_class);
                 for(int i=0; i < model->nr_class ; i++) {
@@ -538,6 +787,18 @@ class NodeSvm : public Nan::ObjectWrap
                 Local<String> str_r = Nan::New<String>("r").ToLocalChecked();
                 parameters->Set(str_r, Nan::New<Number>(model->param.coef0));
             }
+            if (model->param.fast_math == 1){
+                Local<String> str_fast_kernel_math = Nan::New<String>("fastKernelMath").ToLocalChecked();
+                parameters->Set(str_fast_kernel_math, Nan::True());
+            }
+            if (model->param.approximation != NO_APPROXIMATION){
+                Local<String> str_approximation = Nan::New<String>("approximation").ToLocalChecked();
+                Local<String> str_approximation_rank = Nan::New<String>("approximationRank").ToLocalChecked();
+                Local<String> str_approximation_seed = Nan::New<String>("approximationSeed").ToLocalChecked();
+                parameters->Set(str_approximation, Nan::New<Number>(model->param.approximation));
+                parameters->Set(str_approximation_rank, Nan::New<Number>(model->param.approx_rank));
+                parameters->Set(str_approximation_seed, Nan::New<Number>(model->param.approx_seed));
+            }
 
             // Handle<Array> weightLabels = NanNew<Array>(model->param.nr_weight);
             // Handle<Array> weights = NanNew<Array>(model->param.nr_weight);
@@ -570,15 +831,64 @@ class NodeSvm : public Nan::ObjectWrap
                 parameters->Set(str_probability, Nan::False());
             }
 
+            if (model->param.threads > 1){
+                Local<String> str_threads = Nan::New<String>("threads").ToLocalChecked();
+                parameters->Set(str_threads, Nan::New<Number>(model->param.threads));
+            }
+            if (model->param.half_cache == 1){
+                Local<String> str_half_precision_cache = Nan::New<String>("halfPrecisionCache").ToLocalChecked();
+                parameters->Set(str_half_precision_cache, Nan::True());
+            }
+            if (model->param.cache_policy != LRU_CACHE){
+                Local<String> str_cache_policy = Nan::New<String>("cachePolicy").ToLocalChecked();
+                parameters->Set(str_cache_policy, Nan::New<Number>(model->param.cache_policy));
+            }
+            if (model->param.share_kernel == 0){
+                Local<String> str_share_kernel = Nan::New<String>("shareKernel").ToLocalChecked();
+                parameters->Set(str_share_kernel, Nan::False());
+            }
+
             Local<String> str_params = Nan::New<String>("params").ToLocalChecked();
             obj->Set(str_params, parameters);
             return obj;
         };
+
+        // statistics of the last training (see svm_training_stats)
+        Local<Object> getTrainingStats(){
+            Local<Object> obj = Nan::New<Object>();
+            long long columns = trainingStats.cache_hits + trainingStats.cache_misses;
+
+            Local<String> str_cache_hits = Nan::New<String>("cacheHits").ToLocalChecked();
+            Local<String> str_cache_misses = Nan::New<String>("cacheMisses").ToLocalChecked();
+            Local<String> str_cache_hit_rate = Nan::New<String>("cacheHitRate").ToLocalChecked();
+            Local<String> str_cache_evictions = Nan::New<String>("cacheEvictions").ToLocalChecked();
+            Local<String> str_columns_recomputed = Nan::New<String>("columnsRecomputed").ToLocalChecked();
+            Local<String> str_cache_bytes = Nan::New<String>("cacheBytes").ToLocalChecked();
+            Local<String> str_kernel_evaluations = Nan::New<String>("kernelEvaluations").ToLocalChecked();
+            Local<String> str_max_cache_error = Nan::New<String>("maxCacheError").ToLocalChecked();
+            obj->Set(str_cache_hits, Nan::New<Number>((double)trainingStats.cache_hits));
+            obj->Set(str_cache_misses, Nan::New<Number>((double)trainingStats.cache_misses));
+            obj->Set(str_cache_hit_rate, Nan::New<Number>(columns > 0 ? (double)trainingStats.cache_hits / columns : 0));
+            obj->Set(str_cache_evictions, Nan::New<Number>((double)trainingStats.cache_evictions));
+            obj->Set(str_columns_recomputed, Nan::New<Number>((double)trainingStats.cache_recomputed));
+            obj->Set(str_cache_bytes, Nan::New<Number>((double)trainingStats.cache_bytes));
+            obj->Set(str_kernel_evaluations, Nan::New<Number>((double)trainingStats.kernel_evaluations));
+            obj->Set(str_max_cache_error, Nan::New<Number>(trainingStats.max_cache_error));
+            return obj;
+        };
   private:
     ~NodeSvm();
     struct svm_parameter *params;
     struct svm_model *model;
     struct svm_problem *trainingProblem;
+    std::vector<SharedSvmProblem> trainingNodeOwners;
+    const double *trainingGram;
+    int trainingGramSize;
+    int nbFeatures;
+    SharedKernelStore trainingKernelStore;
+    double kernelStoreSize;
+    bool autoCacheSize;
+    struct svm_training_stats trainingStats;
     static Nan::Persistent<Function> constructor;
 
 };
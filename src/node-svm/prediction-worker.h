@@ -10,6 +10,8 @@ class PredictionWorker : public Nan::AsyncWorker {
   PredictionWorker(NodeSvm *svm, Local<Array> inputs, Nan::Callback *callback)
     : Nan::AsyncWorker(callback) {
       obj = svm;
+      // keep the classifier (and the memory it owns) alive until the work is done
+      SaveToPersistent("svm", svm->handle());
       x = new svm_node[inputs->Length() + 1];
       obj->getSvmNodes(inputs, x);
     }
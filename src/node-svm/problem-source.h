@@ -0,0 +1,295 @@
+#ifndef _NODE_SVM_PROBLEM_SOURCE_H
+#define _NODE_SVM_PROBLEM_SOURCE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include <memory>
+#include <node.h>
+#include <nan.h>
+#include "../libsvm/svm.h"
+#include "svm-problem.h"
+
+using namespace v8;
+
+// svm_kernel_store shared by the trainings using it (see Dataset::getKernelStore)
+typedef std::shared_ptr<struct svm_kernel_store> SharedKernelStore;
+
+//
+// Training data waiting to become an svm_problem.
+//
+// Sources are created on the main thread, where they copy (JS arrays) or
+// reference (typed arrays) the training data, then built with `build`, which
+// does not touch V8 and is typically called from a worker thread.
+// Anything wrong with the data itself is reported by `build` (NULL result
+// and `error` set) rather than asserted, so that async callers get an error.
+//
+// Typed array memory is only referenced: callers must keep the arrays alive
+// until `build` returns (see TrainingWorker).
+//
+class ProblemSource {
+ public:
+  ProblemSource() : nbFeatures(0), error(NULL), gram(NULL), gramSize(0) {}
+  virtual ~ProblemSource() {}
+
+  virtual struct svm_problem *build() = 0;
+
+  int nbFeatures;    // set by build()
+  const char *error; // set by build() on failure
+  // storage the built problem's nodes live in, when they are not in the problem itself
+  std::vector<SharedSvmProblem> nodeOwners;
+  // kernel matrix of a precomputed kernel problem (see PrecomputedProblemSource)
+  const double *gram;
+  int gramSize;
+  // kernel columns shared with other trainings on the same rows (see DatasetProblemSource)
+  SharedKernelStore kernelStore;
+};
+
+// [[x0, y0], [x1, y1], ...] JS arrays: copied once into a flat row-major buffer
+class ArrayProblemSource : public ProblemSource {
+ public:
+  ArrayProblemSource(Local<Array> dataset)
+    : features(NULL), labels(NULL), nbRows(0), nbColumns(-1), copyError(NULL) {
+      Nan::HandleScope scope;
+      if (dataset->Length() == 0) {
+        copyError = "dataset is empty";
+        return;
+      }
+
+      nbRows = dataset->Length();
+      labels = new double[nbRows];
+      for (int i = 0; i < nbRows; i++) {
+        Local<Value> t = dataset->Get(i);
+        if (!t->IsArray() || t.As<Array>()->Length() != 2) {
+          copyError = "each example must be an array of 2 elements: [inputs, output]";
+          return;
+        }
+        Local<Array> ex = t.As<Array>();
+        Local<Value> tin = ex->Get(0);
+        Local<Value> tout = ex->Get(1);
+        if (!tin->IsArray() || !tout->IsNumber()) {
+          copyError = "each example must be an array of 2 elements: [inputs, output]";
+          return;
+        }
+
+        Local<Array> x = tin.As<Array>();
+        if (nbColumns == -1) {
+          nbColumns = x->Length();
+          features = new double[(size_t)nbRows * nbColumns];
+        }
+        else if (nbColumns != (int)x->Length()) {
+          copyError = "incorrect dataset: all inputs should have the same length";
+          return;
+        }
+
+        double *row = features + (size_t)i * nbColumns;
+        for (int j = 0; j < nbColumns; ++j) {
+          row[j] = x->Get(j)->NumberValue();
+        }
+        labels[i] = tout->NumberValue();
+      }
+    }
+  ~ArrayProblemSource() {
+    delete[] features;
+    delete[] labels;
+  }
+
+  struct svm_problem *build() {
+    if (copyError != NULL) {
+      error = copyError;
+      return NULL;
+    }
+    nbFeatures = nbColumns;
+    return newDenseSvmProblem(features, nbRows, nbColumns, labels);
+  }
+
+ private:
+  double *features;
+  double *labels;
+  int nbRows;
+  int nbColumns;
+  const char *copyError;
+};
+
+// dense row-major nb_rows x nb_features matrix (typed array backing store)
+template <typename T, typename U>
+class MatrixProblemSource : public ProblemSource {
+ public:
+  MatrixProblemSource(const T *features, int nb_rows, int nb_features, const U *labels)
+    : features(features), labels(labels), nbRows(nb_rows), nbColumns(nb_features) {}
+
+  struct svm_problem *build() {
+    nbFeatures = nbColumns;
+    return newDenseSvmProblem(features, nbRows, nbColumns, labels);
+  }
+
+ private:
+  const T *features;
+  const U *labels;
+  int nbRows;
+  int nbColumns;
+};
+
+// CSR matrix (typed array backing stores), see newCsrSvmProblem
+template <typename T, typename U>
+class CsrProblemSource : public ProblemSource {
+ public:
+  CsrProblemSource(const int32_t *indptr, const int32_t *indices, const T *values, int nb_rows, const U *labels)
+    : indptr(indptr), indices(indices), values(values), labels(labels), nbRows(nb_rows) {}
+
+  struct svm_problem *build() {
+    return newCsrSvmProblem(indptr, indices, values, nbRows, labels, &nbFeatures, &error);
+  }
+
+ private:
+  const int32_t *indptr;
+  const int32_t *indices;
+  const T *values;
+  const U *labels;
+  int nbRows;
+};
+
+// n x n row-major kernel matrix (typed array backing store) of a precomputed
+// kernel: row i only holds the serial number of sample i (libsvm convention),
+// kernel values are read from the matrix by libsvm (see svm_parameter.gram)
+template <typename U>
+class PrecomputedProblemSource : public ProblemSource {
+ public:
+  PrecomputedProblemSource(const double *kernel_matrix, int n, const U *labels)
+    : labels(labels), nbRows(n) {
+      gram = kernel_matrix;
+      gramSize = n;
+    }
+
+  struct svm_problem *build() {
+    struct svm_problem *prob = allocSvmProblem(nbRows, 2 * (size_t)nbRows);
+    struct svm_node *x_space = getSvmProblemNodes(prob);
+    for (int i = 0; i < nbRows; i++) {
+      prob->x[i] = x_space;
+      x_space[0].index = 0;
+      x_space[0].value = i + 1;
+      x_space[1].index = -1;
+      x_space += 2;
+      prob->y[i] = labels[i];
+    }
+    return prob;
+  }
+
+ private:
+  const U *labels;
+  int nbRows;
+};
+
+// Labels may be a Float64Array, a Float32Array or an Int32Array:
+// return `factory(labels)` with a pointer to their backing store
+template <typename Factory>
+static ProblemSource *withLabels(Local<Value> labels, int nb_rows, Factory factory) {
+    if (labels->IsFloat64Array()) {
+        Nan::TypedArrayContents<double> y(labels);
+        assert((int)y.length() == nb_rows);
+        return factory(*y);
+    }
+    else if (labels->IsFloat32Array()) {
+        Nan::TypedArrayContents<float> y(labels);
+        assert((int)y.length() == nb_rows);
+        return factory(*y);
+    }
+    else {
+        assert(labels->IsInt32Array());
+        Nan::TypedArrayContents<int32_t> y(labels);
+        assert((int)y.length() == nb_rows);
+        return factory(*y);
+    }
+}
+
+template <typename T>
+struct MatrixSourceFactory {
+    const T *features; int nb_rows; int nb_features;
+    template <typename U> ProblemSource *operator()(const U *labels) const {
+        return new MatrixProblemSource<T, U>(features, nb_rows, nb_features, labels);
+    }
+};
+
+// expects (features, nbRows, nbFeatures, labels) where features is a row-major
+// Float64Array or Float32Array and labels a Float64Array, Float32Array or Int32Array.
+// The returned source references the typed arrays memory.
+static ProblemSource *newMatrixProblemSource(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    assert(info[1]->IsInt32());
+    assert(info[2]->IsInt32());
+    int nb_rows = info[1]->IntegerValue();
+    int nb_features = info[2]->IntegerValue();
+    assert(nb_rows > 0 && nb_features > 0);
+
+    if (info[0]->IsFloat64Array()) {
+        Nan::TypedArrayContents<double> x(info[0]);
+        assert(x.length() == (size_t)nb_rows * nb_features);
+        MatrixSourceFactory<double> factory = { *x, nb_rows, nb_features };
+        return withLabels(info[3], nb_rows, factory);
+    }
+    else {
+        assert(info[0]->IsFloat32Array());
+        Nan::TypedArrayContents<float> x(info[0]);
+        assert(x.length() == (size_t)nb_rows * nb_features);
+        MatrixSourceFactory<float> factory = { *x, nb_rows, nb_features };
+        return withLabels(info[3], nb_rows, factory);
+    }
+}
+
+struct PrecomputedSourceFactory {
+    const double *gram; int n;
+    template <typename U> ProblemSource *operator()(const U *labels) const {
+        return new PrecomputedProblemSource<U>(gram, n, labels);
+    }
+};
+
+// expects (gram, n, labels) where gram is the n x n row-major Float64Array of the
+// kernel values of every pair of training samples and labels a Float64Array,
+// Float32Array or Int32Array. The returned source references the typed arrays memory.
+static ProblemSource *newPrecomputedProblemSource(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    assert(info[0]->IsFloat64Array());
+    assert(info[1]->IsInt32());
+    int n = info[1]->IntegerValue();
+    assert(n > 0);
+    Nan::TypedArrayContents<double> gram(info[0]);
+    assert(gram.length() == (size_t)n * n);
+    PrecomputedSourceFactory factory = { *gram, n };
+    return withLabels(info[2], n, factory);
+}
+
+template <typename T>
+struct CsrSourceFactory {
+    const int32_t *indptr; const int32_t *indices; const T *values; int nb_rows;
+    template <typename U> ProblemSource *operator()(const U *labels) const {
+        return new CsrProblemSource<T, U>(indptr, indices, values, nb_rows, labels);
+    }
+};
+
+// expects (indptr, indices, values, labels) where indptr and indices are Int32Array,
+// values a Float64Array or a Float32Array and labels a Float64Array, Float32Array or Int32Array.
+// The returned source references the typed arrays memory.
+static ProblemSource *newCsrProblemSource(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    assert(info[0]->IsInt32Array());
+    assert(info[1]->IsInt32Array());
+    Nan::TypedArrayContents<int32_t> indptr(info[0]);
+    Nan::TypedArrayContents<int32_t> indices(info[1]);
+    int nb_rows = indptr.length() - 1;
+    assert(nb_rows > 0);
+    assert((size_t)(*indptr)[nb_rows] == indices.length());
+
+    if (info[2]->IsFloat64Array()) {
+        Nan::TypedArrayContents<double> values(info[2]);
+        assert(values.length() == indices.length());
+        CsrSourceFactory<double> factory = { *indptr, *indices, *values, nb_rows };
+        return withLabels(info[3], nb_rows, factory);
+    }
+    else {
+        assert(info[2]->IsFloat32Array());
+        Nan::TypedArrayContents<float> values(info[2]);
+        assert(values.length() == indices.length());
+        CsrSourceFactory<float> factory = { *indptr, *indices, *values, nb_rows };
+        return withLabels(info[3], nb_rows, factory);
+    }
+}
+
+#endif /* _NODE_SVM_PROBLEM_SOURCE_H */
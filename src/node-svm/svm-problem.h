@@ -0,0 +1,154 @@
+#ifndef _NODE_SVM_PROBLEM_H
+#define _NODE_SVM_PROBLEM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <memory>
+#include "../libsvm/svm.h"
+
+//
+// svm_problem arena
+//
+// The problem header, labels (y), row pointers (x) and all the svm_node of the
+// problem live in one single allocation: rows are contiguous in memory (kernel
+// evaluations walk them sequentially) and the whole problem is released with
+// one call to freeSvmProblem.
+//
+// prob->x[i] must be set by the caller, typically by walking the node space
+// returned by getSvmProblemNodes.
+//
+static inline size_t alignSvmProblemOffset(size_t offset){
+    const size_t alignment = sizeof(double);
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static inline struct svm_problem *allocSvmProblem(int l, size_t nb_nodes){
+    assert(l > 0);
+    size_t y_offset = alignSvmProblemOffset(sizeof(struct svm_problem));
+    size_t x_offset = alignSvmProblemOffset(y_offset + l * sizeof(double));
+    size_t nodes_offset = alignSvmProblemOffset(x_offset + l * sizeof(struct svm_node *));
+    size_t size = nodes_offset + nb_nodes * sizeof(struct svm_node);
+
+    char *block = (char *)malloc(size);
+    assert(block != NULL);
+    struct svm_problem *prob = (struct svm_problem *)block;
+    prob->l = l;
+    prob->y = (double *)(block + y_offset);
+    prob->x = (struct svm_node **)(block + x_offset);
+    return prob;
+}
+
+static inline struct svm_node *getSvmProblemNodes(struct svm_problem *prob){
+    size_t x_offset = (char *)prob->x - (char *)prob;
+    size_t nodes_offset = alignSvmProblemOffset(x_offset + prob->l * sizeof(struct svm_node *));
+    return (struct svm_node *)((char *)prob + nodes_offset);
+}
+
+static inline void freeSvmProblem(struct svm_problem *prob){
+    free(prob);
+}
+
+// Problem whose nodes are shared by several training problems (see Dataset):
+// the arena is released with its last reference, from whichever thread.
+typedef std::shared_ptr<struct svm_problem> SharedSvmProblem;
+
+static inline SharedSvmProblem shareSvmProblem(struct svm_problem *prob){
+    return SharedSvmProblem(prob, freeSvmProblem);
+}
+
+//
+// svm_problem builders
+//
+// They do not touch V8 and can safely run in a worker thread.
+// Zero features are not stored: kernels only walk actual non-zeros.
+//
+
+// Build a problem from a dense row-major matrix of nb_rows x nb_features
+template <typename T, typename U>
+static struct svm_problem *newDenseSvmProblem(const T *features, int nb_rows, int nb_features, const U *labels){
+    size_t size = (size_t)nb_rows * nb_features;
+    size_t nb_nodes = nb_rows; // one terminal node per row
+    for (size_t k = 0; k < size; k++) {
+        if (features[k] != 0)
+            nb_nodes++;
+    }
+
+    struct svm_problem *prob = allocSvmProblem(nb_rows, nb_nodes);
+    struct svm_node *x_space = getSvmProblemNodes(prob);
+    for (int i = 0; i < nb_rows; i++) {
+        const T *row = features + (size_t)i * nb_features;
+        prob->x[i] = x_space;
+        for (int j = 0; j < nb_features; j++) {
+            if (row[j] != 0) {
+                x_space->index = j+1;
+                x_space->value = row[j];
+                x_space++;
+            }
+        }
+        (x_space++)->index = -1;
+        prob->y[i] = labels[i];
+    }
+    return prob;
+}
+
+// Fill nodes with the non-zeros of a CSR row and return the end of the filled nodes
+// (no terminal node added), or NULL if column indices are negative, too large for the
+// 1-based svm_node index or not increasing.
+// nodes must have room for end - begin elements.
+template <typename T>
+static struct svm_node *getCsrSvmNodes(const int32_t *indices, const T *values, int32_t begin, int32_t end, struct svm_node *nodes){
+    for (int32_t k = begin; k < end; k++) {
+        if (indices[k] < 0 || indices[k] >= INT32_MAX || (k > begin && indices[k] <= indices[k-1]))
+            return NULL;
+        if (values[k] != 0) {
+            nodes->index = indices[k] + 1;
+            nodes->value = values[k];
+            nodes++;
+        }
+    }
+    return nodes;
+}
+
+// Build a problem from a CSR matrix: row i non-zeros are values[indptr[i]..indptr[i+1])
+// with (0-based, increasing) column indices taken from indices.
+// Return NULL and set error if the matrix is malformed.
+template <typename T, typename U>
+static struct svm_problem *newCsrSvmProblem(const int32_t *indptr, const int32_t *indices, const T *values, int nb_rows, const U *labels, int *nb_features, const char **error){
+    if (indptr[0] != 0){
+        *error = "indptr must start with 0";
+        return NULL;
+    }
+    size_t nb_nodes = nb_rows; // one terminal node per row
+    for (int i = 0; i < nb_rows; i++) {
+        if (indptr[i] > indptr[i+1]){
+            *error = "indptr must not decrease";
+            return NULL;
+        }
+    }
+    for (int32_t k = 0; k < indptr[nb_rows]; k++) {
+        if (values[k] != 0)
+            nb_nodes++;
+    }
+
+    struct svm_problem *prob = allocSvmProblem(nb_rows, nb_nodes);
+    struct svm_node *x_space = getSvmProblemNodes(prob);
+    int max_index = 0;
+    for (int i = 0; i < nb_rows; i++) {
+        prob->x[i] = x_space;
+        x_space = getCsrSvmNodes(indices, values, indptr[i], indptr[i+1], x_space);
+        if (x_space == NULL){
+            freeSvmProblem(prob);
+            *error = "column indices must be in [0, 2147483646] and sorted within each row";
+            return NULL;
+        }
+        if (x_space != prob->x[i] && x_space[-1].index > max_index)
+            max_index = x_space[-1].index;
+        (x_space++)->index = -1;
+        prob->y[i] = labels[i];
+    }
+    *nb_features = max_index;
+    return prob;
+}
+
+#endif /* _NODE_SVM_PROBLEM_H */
@@ -2,23 +2,35 @@
 #define _NODE_SVM_TRAINING_WORKER_H
 
 #include "node-svm.h"
+#include "problem-source.h"
 
 using namespace v8;
 
 class TrainingWorker : public Nan::AsyncWorker {
  public:
-  TrainingWorker(NodeSvm *svm, Local<Array> dataset, Nan::Callback *callback)
-    : Nan::AsyncWorker(callback) {
+  // The worker owns `source`. Typed arrays it references must be
+  // kept alive by the caller (see SaveToPersistent)
+  TrainingWorker(NodeSvm *svm, ProblemSource *source, Nan::Callback *callback)
+    : Nan::AsyncWorker(callback), source(source) {
       obj = svm;
-      obj->setSvmProblem(dataset);
+      // keep the classifier (and the memory it owns) alive until the work is done
+      SaveToPersistent("svm", svm->handle());
     }
-  ~TrainingWorker() {}
+  ~TrainingWorker() {
+    delete source;
+  }
 
   // Executed inside the worker-thread.
   // It is not safe to access V8, or V8 data structures
   // here, so everything we need for input and output
   // should go on `this`.
   void Execute () {
+    struct svm_problem *prob = source->build();
+    if (prob == NULL) {
+      SetErrorMessage(source->error);
+      return;
+    }
+    obj->setTrainingProblem(prob, source->nbFeatures, source->nodeOwners, source->gram, source->gramSize, source->kernelStore);
     obj->train();
   }
 
@@ -40,6 +52,7 @@ class TrainingWorker : public Nan::AsyncWorker {
 
  private:
   NodeSvm *obj;
+  ProblemSource *source;
 };
 
 #endif /* _NODE_SVM_TRAINING_WORKER_H */
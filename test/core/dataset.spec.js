@@ -0,0 +1,118 @@
+'use strict';
+
+var expect = require('expect.js');
+var Dataset = require('../../lib/core/dataset');
+var BaseSVM = require('../../lib/core/base-svm');
+var kernelTypes = require('../../lib/core/kernel-types');
+
+var xor = [
+    [[0, 0], 0],
+    [[0, 1], 1],
+    [[1, 0], 1],
+    [[1, 1], 0]
+];
+
+// train a new RBF classifier on a dataset, resolves to [model, training statistics]
+function trainWithStats(dataset, c, kernelStoreSize) {
+    var clf = new BaseSVM();
+    var config = { kernelType: kernelTypes.RBF, c: c, gamma: 0.5, kernelStoreSize: kernelStoreSize };
+    return clf.train(dataset, config).then(function (model) {
+        return [model, clf.getTrainingStats()];
+    });
+}
+
+describe('Dataset', function () {
+    var dataset;
+    beforeEach(function () {
+        dataset = new Dataset(xor.slice(0, 2))
+            .appendMatrix(new Float64Array([1, 0, 1, 1]), 2, 2, new Int32Array([1, 0]));
+    });
+
+    it('should contain appended rows', function () {
+        expect(dataset.size()).to.be(4);
+        expect(dataset.nbFeatures()).to.be(2);
+    });
+
+    it('can be used to train a classifier', function (done) {
+        var clf = new BaseSVM();
+        clf.train(dataset, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 })
+            .then(function () {
+                xor.forEach(function (ex) {
+                    expect(clf.predictSync(ex[0])).to.be(ex[1]);
+                });
+            }).done(function(){
+                done();
+            });
+    });
+
+    it('can be used to train on a subset of its rows', function (done) {
+        var subset = dataset.subset([0, 1, 3]);
+        expect(subset.size()).to.be(3);
+        expect(subset.subset([2])._indexes[0]).to.be(3);
+
+        var clf = new BaseSVM();
+        clf.train(subset, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 })
+            .then(function (model) {
+                expect(model.l).to.be.below(4);
+                // trained models do not depend on further appends
+                dataset.appendRows(xor);
+                expect(clf.predictSync([0, 1])).to.be(1);
+            }).done(function(){
+                done();
+            });
+    });
+
+    it('can share kernel columns between trainings with the same kernel', function (done) {
+        var rows = new Dataset().appendFile('./examples/datasets/svmguide2.ds');
+        var alone;
+        trainWithStats(rows, 1, 0)
+            .then(function (result) {
+                alone = result;
+                return trainWithStats(rows, 0.5, 10);
+            })
+            .then(function () {
+                return trainWithStats(rows, 1, 10);
+            })
+            .then(function (shared) {
+                // same model, from the columns computed by the previous training
+                expect(shared[0].rho).to.eql(alone[0].rho);
+                expect(shared[0].supportVectors).to.eql(alone[0].supportVectors);
+                expect(shared[1].kernelEvaluations).to.be.below(alone[1].kernelEvaluations);
+            }).done(function(){
+                done();
+            });
+    });
+
+    it('should not compute more kernel values with a kernel store too small for the search', function (done) {
+        // 0.01MB holds 6 of the 391 columns of svmguide2: the others are computed by each training, for its own rows
+        var rows = new Dataset().appendFile('./examples/datasets/svmguide2.ds');
+        var alone;
+        trainWithStats(rows, 1, 0)
+            .then(function (result) {
+                alone = result;
+                return trainWithStats(rows, 0.5, 0.01);
+            })
+            .then(function () {
+                return trainWithStats(rows, 1, 0.01);
+            })
+            .then(function (small) {
+                expect(small[0].rho).to.eql(alone[0].rho);
+                expect(small[1].kernelEvaluations).not.to.be.above(alone[1].kernelEvaluations);
+            }).done(function(){
+                done();
+            });
+    });
+
+    it('can be split into folds of row indexes', function () {
+        var folds = dataset.splitFolds(2, true);
+        expect(folds.length).to.be(2);
+        folds.forEach(function (fold) {
+            expect(fold.train).to.be.an(Int32Array);
+            expect(fold.train.length + fold.test.length).to.be(4);
+            // stratified: one example of each class per fold
+            expect(fold.test.length).to.be(2);
+        });
+        var tested = Array.prototype.slice.call(folds[0].test).concat(Array.prototype.slice.call(folds[1].test));
+        expect(tested.sort()).to.eql([0, 1, 2, 3]);
+    });
+});
@@ -1,11 +1,18 @@
 'use strict';
 
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
 var expect = require('expect.js');
 var Q = require('q');
+var _o = require('mout/object');
+var addon = require('../../build/Release/addon');
 var BaseSVM = require('../../lib/core/base-svm');
 var SVM = require('../../lib/core/svm');
 var svmTypes = require('../../lib/core/svm-types');
 var kernelTypes = require('../../lib/core/kernel-types');
+var approximationTypes = require('../../lib/core/approximation-types');
+var cachePolicies = require('../../lib/core/cache-policies');
 
 var xor = [
     [[0, 0], 0],
@@ -26,6 +33,14 @@ var redundantXor = [
     [[1, 1, 1, 1], 0]
 ];
 
+// train a new classifier on a dataset file, resolves to [model, training statistics]
+function trainWithStats(file, config) {
+    var clf = new BaseSVM();
+    return clf.trainFromFile(file, config).then(function (model) {
+        return [model, clf.getTrainingStats()];
+    });
+}
+
 describe('baseSVM', function () {
     var baseSvm;
     beforeEach(function () {
@@ -45,6 +60,507 @@ describe('baseSVM', function () {
                 done();
             });
     });
+    it('can be trained from a typed-array matrix', function (done) {
+        var x = new Float64Array([0, 0, 0, 1, 1, 0, 1, 1]),
+            y = new Int32Array([0, 1, 1, 0]);
+        baseSvm.trainMatrix(x, 4, 2, y, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 })
+            .then(function (model) {
+                expect(model.nrClass).to.be(2);
+                xor.forEach(function (ex) {
+                    expect(baseSvm.predictSync(ex[0])).to.be(ex[1]);
+                });
+            }).done(function(){
+                done();
+            });
+    });
+    it('can be trained from and predict a CSR matrix', function (done) {
+        // xor with zeros left out
+        var indptr = new Int32Array([0, 0, 1, 2, 4]),
+            indices = new Int32Array([1, 0, 0, 1]),
+            values = new Float64Array([1, 1, 1, 1]),
+            y = new Int32Array([0, 1, 1, 0]);
+        baseSvm.trainCsr(indptr, indices, values, y, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 })
+            .then(function (model) {
+                expect(baseSvm.predictCsrSync(indptr, indices, values)).to.eql([0, 1, 1, 0]);
+                // zeros are not stored but SVs are still reported as dense inputs
+                model.supportVectors.forEach(function (sv) {
+                    expect(sv[0].length).to.be(2);
+                });
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject CSR column indexes out of the svm_node range', function (done) {
+        // svm_node indexes are 1-based ints: column 2^31 - 1 would overflow
+        var indptr = new Int32Array([0, 1, 2]),
+            indices = new Int32Array([0, 2147483647]),
+            values = new Float64Array([1, 1]),
+            y = new Int32Array([0, 1]);
+        baseSvm.trainCsr(indptr, indices, values, y, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 })
+            .then(function () {
+                throw new Error('should have been rejected');
+            }, function (err) {
+                expect(err.code).to.be('EINVDATASET');
+            }).done(function(){
+                done();
+            });
+    });
+    it('can be trained from and predict a precomputed kernel matrix', function (done) {
+        var rbf = function (a, b) {
+            return Math.exp(-0.5 * ((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1])));
+        };
+        var gram = new Float64Array(16),
+            y = new Int32Array([0, 1, 1, 0]);
+        xor.forEach(function (exI, i) {
+            xor.forEach(function (exJ, j) {
+                gram[i * 4 + j] = rbf(exI[0], exJ[0]);
+            });
+        });
+        baseSvm.trainPrecomputed(gram, 4, y, { c: 1 })
+            .then(function (model) {
+                expect(model.params.kernelType).to.be(kernelTypes.PRECOMPUTED);
+                // K(x, sv) for each xor example and each SV, SVs being training samples
+                var svs = model.supportVectors.map(function (sv) { return xor[sv[0][0]][0]; });
+                var kernelValues = new Float64Array(4 * svs.length);
+                xor.forEach(function (ex, i) {
+                    svs.forEach(function (sv, j) {
+                        kernelValues[i * svs.length + j] = rbf(ex[0], sv);
+                    });
+                });
+                expect(baseSvm.predictPrecomputedSync(kernelValues, 4)).to.eql([0, 1, 1, 0]);
+                expect(BaseSVM.restore(model).predictPrecomputedSync(kernelValues, 4)).to.eql([0, 1, 1, 0]);
+                // feature vectors can not be predicted, kernel values must be given for every SV
+                expect(function () { baseSvm.predictSync(xor[0][0]); }).to.throwError();
+                expect(function () { baseSvm.predictProbabilitiesSync(xor[0][0]); }).to.throwError();
+                expect(function () { baseSvm.predictPrecomputedSync(kernelValues.subarray(0, 4 * (svs.length - 1)), 4); }).to.throwError();
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject precomputed kernel without kernel matrix', function (done) {
+        baseSvm.train(xor, { kernelType: kernelTypes.PRECOMPUTED })
+            .fail(function (err) {
+                expect(err.code).to.be('EINVPARAMS');
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject probability estimates for a precomputed kernel matrix', function (done) {
+        var clf = new addon.NodeSvm();
+        var params = { svmType: svmTypes.C_SVC, kernelType: kernelTypes.PRECOMPUTED, c: 1, probability: true };
+        expect(clf.setParameters(params)).to.be.a('string');
+        baseSvm.trainPrecomputed(new Float64Array([1, 0, 0, 1]), 2, new Int32Array([0, 1]), { probability: true })
+            .then(function () {
+                throw new Error('should not be trained');
+            })
+            .fail(function (err) {
+                expect(err.code).to.be('EINVPARAMS');
+            }).done(function(){
+                done();
+            });
+    });
+    it('can be retrained in place', function () {
+        var clf = new addon.NodeSvm();
+        clf.setParameters({ svmType: svmTypes.C_SVC, kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 });
+        for (var i = 0; i < 10; i++) {
+            clf.train(xor);
+        }
+        expect(clf.isTrained()).to.be(true);
+        xor.forEach(function (ex) {
+            expect(clf.predict(ex[0])).to.be(ex[1]);
+        });
+    });
+    it('should size an auto kernel cache from the training set', function () {
+        var clf = new addon.NodeSvm();
+        var params = { svmType: svmTypes.C_SVC, kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, cacheSize: 'auto' };
+        expect(clf.setParameters(params)).to.be(undefined);
+        clf.train(xor);
+        // the 4 x 4 kernel matrix, rounded up to 1MB
+        expect(clf.getModel().params.cacheSize).to.be(1);
+        xor.forEach(function (ex) {
+            expect(clf.predict(ex[0])).to.be(ex[1]);
+        });
+        expect(clf.setParameters(_o.merge(params, { cacheSize: 'large' }))).to.be.a('string');
+        expect(clf.setParameters(_o.merge(params, { cacheSize: 0 }))).to.be.a('string');
+    });
+    it('should reject invalid cache size', function (done) {
+        baseSvm.train(xor, { cacheSize: -1 })
+            .fail(function (err) {
+                expect(err.code).to.be('EINVPARAMS');
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject invalid dataset asynchronously', function (done) {
+        baseSvm.train([[[0, 0], 0], [[0, 1, 1], 1]])
+            .fail(function (err) {
+                expect(err.code).to.be('EINVDATASET');
+                expect(baseSvm.isTrained()).to.be(false);
+            }).done(function(){
+                done();
+            });
+    });
+    it('can be trained from and predict a dataset file', function (done) {
+        baseSvm.trainFromFile('./examples/datasets/xor.ds', { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5 })
+            .then(function (model) {
+                expect(model.nrClass).to.be(2);
+                return baseSvm.predictFile('./examples/datasets/xor.ds');
+            })
+            .then(function (result) {
+                expect(result.predictions).to.eql(result.expected);
+            }).done(function(){
+                done();
+            });
+    });
+    it('should keep decision values close to the exact ones with fast kernel math', function (done) {
+        // epsilon-SVR predictions are raw decision values
+        var file = './examples/datasets/svmguide2.ds';
+        var predict = function (kernelType, fastKernelMath) {
+            var clf = new BaseSVM();
+            var config = { svmType: svmTypes.EPSILON_SVR, kernelType: kernelType, c: 1, gamma: 0.25, r: 0, epsilon: 0.1, fastKernelMath: fastKernelMath };
+            return clf.trainFromFile(file, config)
+                .then(function (model) {
+                    expect(!!model.params.fastKernelMath).to.be(fastKernelMath);
+                    return clf.predictFile(file);
+                })
+                .then(function (result) {
+                    return result.predictions;
+                });
+        };
+        Q.all([
+            predict(kernelTypes.RBF, false), predict(kernelTypes.RBF, true),
+            predict(kernelTypes.SIGMOID, false), predict(kernelTypes.SIGMOID, true)
+        ]).then(function (predictions) {
+            [0, 2].forEach(function (k) {
+                var exact = predictions[k], fast = predictions[k + 1];
+                expect(fast.length).to.be(exact.length);
+                exact.forEach(function (value, i) {
+                    expect(Math.abs(fast[i] - value)).to.be.below(1e-4);
+                });
+            });
+        }).done(function(){
+            done();
+        });
+    });
+    it('should compute the same kernel values as a javascript kernel', function (done) {
+        // dense 8-feature rows are trained with the vectorized dot/dist2/exp/tanh (see select_vector_kernels),
+        // the precomputed models use Math.exp and Math.tanh; arguments of exp span [-858, 0] and tanh [-5.8, 7]
+        var n = 40, d = 8,
+            x = new Float64Array(n * d),
+            y = new Float64Array(n);
+        for (var i = 0; i < n; i++) {
+            for (var k = 0; k < d; k++) {
+                x[i * d + k] = ((i * 7 + k * 13 + i * k) % 41 - 19.5) / 4;
+                y[i] += x[i * d + k] / 8;
+            }
+        }
+        var product = function (i, j, kernel) {
+            var dot = 0, dist2 = 0;
+            for (var k = 0; k < d; k++) {
+                dot += x[i * d + k] * x[j * d + k];
+                dist2 += (x[i * d + k] - x[j * d + k]) * (x[i * d + k] - x[j * d + k]);
+            }
+            switch (kernel.kernelType) {
+                case kernelTypes.LINEAR: return dot;
+                case kernelTypes.POLY: return Math.pow(kernel.gamma * dot + kernel.r, kernel.degree);
+                case kernelTypes.RBF: return Math.exp(-kernel.gamma * dist2);
+                default: return Math.tanh(kernel.gamma * dot + kernel.r);
+            }
+        };
+        var kernels = [
+            { kernelType: kernelTypes.LINEAR },
+            { kernelType: kernelTypes.POLY, gamma: 0.1, r: 1, degree: 3 },
+            { kernelType: kernelTypes.RBF, gamma: 0.02 },
+            { kernelType: kernelTypes.RBF, gamma: 2 },
+            { kernelType: kernelTypes.SIGMOID, gamma: 0.05, r: -1 }
+        ];
+        var near = function (a, b, tolerance) {
+            expect(Math.abs(a - b)).to.be.below(tolerance);
+        };
+        var compare = function (kernel, fastKernelMath) {
+            var config = _o.merge({ svmType: svmTypes.EPSILON_SVR, c: 10, epsilon: 0.1, fastKernelMath: fastKernelMath }, kernel);
+            var gram = new Float64Array(n * n);
+            for (var i = 0; i < n; i++) {
+                for (var j = 0; j < n; j++) {
+                    gram[i * n + j] = product(i, j, kernel);
+                }
+            }
+            var clf = new BaseSVM(), precomputed = new BaseSVM();
+            return Q.all([
+                clf.trainMatrix(x, n, d, y, config),
+                precomputed.trainPrecomputed(gram, n, y, config)
+            ]).spread(function (model, exact) {
+                var rows = [];
+                for (var i = 0; i < n; i++) {
+                    rows.push(Array.prototype.slice.call(x, i * d, (i + 1) * d));
+                }
+                if (!fastKernelMath) {
+                    // kernel values only differ by a few ulp, they round to the same cached floats
+                    near(model.rho[0], exact.rho[0], 1e-9);
+                    expect(model.supportVectors.length).to.be(exact.supportVectors.length);
+                    exact.supportVectors.forEach(function (sv, s) {
+                        expect(model.supportVectors[s][0]).to.eql(rows[sv[0][0]]);
+                        near(model.supportVectors[s][1][0], sv[1][0], 1e-9);
+                    });
+                }
+                // decision values of the trained model against its expansion with the javascript kernel
+                var l = model.supportVectors.length, sum = 0;
+                var indexes = model.supportVectors.map(function (sv) {
+                    sum += Math.abs(sv[1][0]);
+                    return rows.map(String).indexOf(String(sv[0]));
+                });
+                var tolerance = fastKernelMath ? 1e-6 * (sum + 1) : 1e-9;
+                rows.forEach(function (row, i) {
+                    var value = -model.rho[0];
+                    for (var s = 0; s < l; s++) {
+                        value += model.supportVectors[s][1][0] * product(i, indexes[s], kernel);
+                    }
+                    near(clf.predictSync(row), value, tolerance);
+                });
+            });
+        };
+        kernels.reduce(function (previous, kernel) {
+            return previous.then(function () {
+                return compare(kernel, false);
+            }).then(function () {
+                return compare(kernel, true);
+            });
+        }, Q()).done(function(){
+            done();
+        });
+    });
+    it('should train the same model with several threads', function (done) {
+        // large enough for kernel columns to be split among threads
+        var n = 10000,
+            x = new Float64Array(2 * n),
+            y = new Int32Array(n);
+        for (var i = 0; i < n; i++) {
+            y[i] = i % 2;
+            x[2 * i] = (y[i] ? 1 : -1) + Math.cos(i);
+            x[2 * i + 1] = Math.sin(i * 7);
+        }
+        var train = function (threads) {
+            return new BaseSVM().trainMatrix(x, n, 2, y, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, threads: threads });
+        };
+        Q.all([train(1), train(4)])
+            .spread(function (model, threadedModel) {
+                expect(threadedModel.params.threads).to.be(4);
+                expect(threadedModel.l).to.be(model.l);
+                expect(threadedModel.rho).to.eql(model.rho);
+                expect(threadedModel.supportVectors).to.eql(model.supportVectors);
+            }).done(function(){
+                done();
+            });
+    });
+    it('should report kernel cache statistics, with or without half precision cache', function (done) {
+        var file = './examples/datasets/svmguide2.ds';
+        var train = function (halfPrecisionCache) {
+            var config = { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, cacheSize: 0.1, halfPrecisionCache: halfPrecisionCache };
+            return trainWithStats(file, config);
+        };
+        Q.all([train(false), train(true)])
+            .spread(function (exact, half) {
+                expect(!!exact[0].params.halfPrecisionCache).to.be(false);
+                expect(half[0].params.halfPrecisionCache).to.be(true);
+                var stats = exact[1], halfStats = half[1];
+                [stats, halfStats].forEach(function (s) {
+                    expect(s.cacheMisses).to.be.above(0);
+                    expect(s.cacheHitRate).to.be(s.cacheHits / (s.cacheHits + s.cacheMisses));
+                    // 0.1MB holds less than the whole kernel matrix
+                    expect(s.cacheEvictions).to.be.above(0);
+                    expect(s.columnsRecomputed).to.be.within(1, s.cacheMisses);
+                    expect(s.cacheBytes).to.be.within(1, 0.2 * 1024 * 1024);
+                });
+                expect(stats.maxCacheError).to.be(0);
+                // RBF kernel values are in (0, 1]: bfloat16 keeps them within 2^-9
+                expect(halfStats.maxCacheError).to.be.above(0);
+                expect(halfStats.maxCacheError).to.be.below(Math.pow(2, -9) + 1e-9);
+            }).done(function(){
+                done();
+            });
+    });
+    it('should train the same model with a small kernel cache and shrinking', function (done) {
+        // 0.1MB evicts columns and drops those left behind by the swaps of shrinking: all of them are computed again
+        var file = './examples/datasets/svmguide2.ds';
+        var train = function (config, cacheSize) {
+            return trainWithStats(file, _o.merge({ c: 1, gamma: 0.5, r: -1, nu: 0.3, epsilon: 0.1, shrinking: true, cacheSize: cacheSize }, config));
+        };
+        var configs = [];
+        [kernelTypes.LINEAR, kernelTypes.POLY, kernelTypes.RBF, kernelTypes.SIGMOID].forEach(function (kernelType) {
+            [svmTypes.C_SVC, svmTypes.NU_SVC, svmTypes.EPSILON_SVR].forEach(function (svmType) {
+                configs.push({ svmType: svmType, kernelType: kernelType });
+            });
+        });
+        var recomputed = 0;
+        configs.reduce(function (previous, config) {
+            return previous.then(function () {
+                return Q.all([train(config, 0.1), train(config, 100)]);
+            }).spread(function (small, large) {
+                expect(small[1].cacheEvictions).to.be.above(0);
+                recomputed += small[1].columnsRecomputed;
+                expect(small[0].rho).to.eql(large[0].rho);
+                expect(small[0].supportVectors).to.eql(large[0].supportVectors);
+            });
+        }, Q()).then(function () {
+            expect(recomputed).to.be.above(0);
+        }).done(function(){
+            done();
+        });
+    });
+    it('should train the same model whatever the kernel cache policy', function (done) {
+        // binary problem shrunk under cache pressure: 1MB holds about 80 of the 3089 columns
+        var file = './examples/datasets/svmguide1.ds';
+        var train = function (cachePolicy) {
+            return trainWithStats(file, { kernelType: kernelTypes.RBF, c: 1000, gamma: 0.001, cacheSize: 1, cachePolicy: cachePolicy });
+        };
+        Q.all([train(cachePolicies.LRU), train(cachePolicies.SHRINKING)])
+            .spread(function (lru, shrinking) {
+                expect(lru[0].params.cachePolicy).to.be(undefined);
+                expect(shrinking[0].params.cachePolicy).to.be(cachePolicies.SHRINKING);
+                expect(shrinking[0].rho).to.eql(lru[0].rho);
+                expect(shrinking[0].supportVectors).to.eql(lru[0].supportVectors);
+                // same columns requested, only evictions differ: shrunk columns go first
+                expect(shrinking[1].cacheHits + shrinking[1].cacheMisses).to.be(lru[1].cacheHits + lru[1].cacheMisses);
+                expect(shrinking[1].cacheEvictions).to.be.above(0);
+                expect(shrinking[1].cacheEvictions).not.to.be(lru[1].cacheEvictions);
+                expect(shrinking[1].cacheHits).to.be.above(lru[1].cacheHits - 1);
+            }).done(function(){
+                done();
+            });
+    });
+    it('should train the same multi-class model whether kernel values are shared between subproblems or not', function (done) {
+        // svmguide2 has 3 classes: 3 one-vs-one subproblems, each class being in 2 of them
+        var file = './examples/datasets/svmguide2.ds';
+        var train = function (shareKernel) {
+            return trainWithStats(file, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, cacheSize: 1, shareKernel: shareKernel });
+        };
+        Q.all([train(false), train(true)])
+            .spread(function (alone, shared) {
+                expect(alone[0].params.shareKernel).to.be(false);
+                expect(shared[0].params.shareKernel).to.be(undefined);
+                expect(shared[0].rho).to.eql(alone[0].rho);
+                expect(shared[0].supportVectors).to.eql(alone[0].supportVectors);
+                expect(alone[1].kernelEvaluations).to.be.above(0);
+                expect(shared[1].kernelEvaluations).to.be.below(alone[1].kernelEvaluations);
+            }).done(function(){
+                done();
+            });
+    });
+    it('can size its kernel cache automatically', function (done) {
+        var clf = new BaseSVM();
+        clf.train(xor, { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, cacheSize: 'auto' })
+            .then(function (model) {
+                // resolved natively: the 4 x 4 kernel matrix, rounded up to 1MB
+                expect(model.params.cacheSize).to.be(1);
+                var stats = clf.getTrainingStats();
+                // no more than the 4 x 4 kernel matrix (and the column headers)
+                expect(stats.cacheBytes).to.be.within(1, 1024);
+                expect(stats.cacheEvictions).to.be(0);
+                expect(stats.columnsRecomputed).to.be(0);
+            }).done(function(){
+                done();
+            });
+    });
+    it('can be trained on an approximate kernel feature map', function (done) {
+        var train = function (approximation) {
+            var config = { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, approximation: approximation, approximationRank: 200 };
+            return new BaseSVM().train(xor, config);
+        };
+        Q.all([train(approximationTypes.NYSTROEM), train(approximationTypes.RANDOM_FOURIER)])
+            .then(function (models) {
+                models.forEach(function (model) {
+                    // a linear model in the approximate feature space: no support vectors
+                    expect(model.l).to.be(0);
+                    expect(model.weights.length).to.be(1);
+                    var restored = BaseSVM.restore(model);
+                    xor.forEach(function (ex) {
+                        expect(restored.predictSync(ex[0])).to.be(ex[1]);
+                    });
+                });
+                // Nystroem landmarks are sampled among the 4 training examples
+                expect(models[0].basis.length).to.be(4);
+                expect(models[1].phase.length).to.be(200);
+            }).done(function(){
+                done();
+            });
+    });
+    it('should be about as accurate as the exact kernel on an approximate kernel feature map', function (done) {
+        // non-linear boundary in 10 dimensions, 1000 training and 1000 test samples
+        // (see examples/approximation-benchmark.js for training times)
+        var d = 10, n = 1000, nTest = 1000, seed = 1;
+        var random = function () {
+            seed = (seed * 16807) % 2147483647;
+            return seed / 2147483647;
+        };
+        var x = new Float64Array((n + nTest) * d),
+            y = new Int32Array(n + nTest);
+        for (var i = 0; i < n + nTest; i++) {
+            for (var k = 0; k < d; k++) {
+                x[i * d + k] = 2 * random() - 1;
+            }
+            var z = x.subarray(i * d, (i + 1) * d);
+            y[i] = Math.sin(3 * z[0]) + z[1] * z[1] - 0.5 + 0.4 * z[2] * z[3] + 0.4 * (random() - 0.5) > 0 ? 1 : 0;
+        }
+        var train = function (approximation) {
+            var clf = new BaseSVM();
+            var config = { kernelType: kernelTypes.RBF, c: 1, gamma: 0.5, approximation: approximation, approximationRank: 100 };
+            return clf.trainMatrix(x.subarray(0, n * d), n, d, y.subarray(0, n), config).then(function (model) {
+                var correct = 0;
+                for (var i = n; i < n + nTest; i++) {
+                    if (clf.predictSync(Array.prototype.slice.call(x, i * d, (i + 1) * d)) === y[i]) {
+                        correct++;
+                    }
+                }
+                return { model: model, accuracy: correct / nTest };
+            });
+        };
+        Q.all([train(approximationTypes.NONE), train(approximationTypes.NYSTROEM)])
+            .spread(function (exact, approximate) {
+                expect(exact.model.l).to.be.above(0);
+                // one linear model over the 100 landmarks, no support vectors
+                expect(approximate.model.l).to.be(0);
+                expect(approximate.model.basis.length).to.be(100);
+                expect(approximate.model.weights.length).to.be(1);
+                expect(approximate.model.weights[0].length).to.be(100);
+                expect(approximate.accuracy).to.be.above(exact.accuracy - 0.03);
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject random Fourier features for kernels other than RBF', function (done) {
+        new BaseSVM().train(xor, { kernelType: kernelTypes.POLY, approximation: approximationTypes.RANDOM_FOURIER })
+            .fail(function (err) {
+                expect(err.code).to.be('EINVPARAMS');
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject unreadable dataset file', function (done) {
+        baseSvm.trainFromFile('./examples/datasets/not-found.ds')
+            .fail(function (err) {
+                expect(err.code).to.be('EINVDATASET');
+            }).done(function(){
+                done();
+            });
+    });
+    it('should reject dataset files with out of range indexes or non-finite numbers', function (done) {
+        var contents = ['1 1:0.5 3000000000:1\n', '1 1:inf\n', 'nan 1:1\n'];
+        Q.all(contents.map(function (content, i) {
+            var file = path.join(os.tmpdir(), 'node-svm-invalid-' + process.pid + '-' + i + '.ds');
+            fs.writeFileSync(file, content);
+            return new BaseSVM().trainFromFile(file)
+                .then(function () {
+                    throw new Error('should have been rejected: ' + content);
+                }, function (err) {
+                    expect(err.code).to.be('EINVDATASET');
+                })
+                .fin(function () {
+                    fs.unlinkSync(file);
+                });
+        })).done(function(){
+            done();
+        });
+    });
     describe('once trained', function () {
         var trainedModel;
         beforeEach(function (done) {
@@ -134,6 +650,12 @@ describe('baseSVM', function () {
                     expect(props).to.have.property('1');
                 });
             });
+            it('should not be restored from a model with invalid params', function(){
+                var model = _o.merge(trainedModel, { params: { cacheSize: -1 } });
+                expect(function () {
+                    BaseSVM.restore(model);
+                }).to.throwError(/cacheSize/);
+            });
         });
     });
 
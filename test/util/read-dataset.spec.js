@@ -1,5 +1,8 @@
 'use strict';
 
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
 var read = require('../../lib/util/read-dataset');
 var numeric = require('numeric');
 var expect = require('expect.js');
@@ -26,7 +29,78 @@ describe('#read', function(){
                     expect(numeric.dim(problem)).to.eql([3089, 2, 4]);
                 }).done(done);
         });
-        
+
+    });
+    describe('libsvm format with cache', function () {
+        var cacheFile = './examples/datasets/svmguide1.ds.svmcache';
+        beforeEach(function () {
+            if (fs.existsSync(cacheFile)){ fs.unlinkSync(cacheFile); }
+        });
+        afterEach(function () {
+            if (fs.existsSync(cacheFile)){ fs.unlinkSync(cacheFile); }
+        });
+        it('should read the same examples, from the cache once it exists', function (done) {
+            read('./examples/datasets/svmguide1.ds')
+                .then(function (expected) {
+                    return read('./examples/datasets/svmguide1.ds', { cache: true })
+                        .then(function (parsed) {
+                            expect(fs.existsSync(cacheFile)).to.be(true);
+                            expect(parsed).to.eql(expected);
+                            return read('./examples/datasets/svmguide1.ds', { cache: true });
+                        })
+                        .then(function (cached) {
+                            expect(cached).to.eql(expected);
+                        });
+                }).done(done);
+        });
+        it('should not read a stale cache after a same-size rewrite of the file', function (done) {
+            var file = path.join(os.tmpdir(), 'node-svm-rewritten-' + process.pid + '.ds');
+            fs.writeFileSync(file, '1 1:0.5\n');
+            read(file, { cache: true })
+                .then(function () {
+                    // same size, within the same second
+                    fs.writeFileSync(file, '1 1:0.7\n');
+                    return read(file, { cache: true });
+                })
+                .then(function (problem) {
+                    expect(problem).to.eql([[[0.7], 1]]);
+                })
+                .fin(function () {
+                    fs.unlinkSync(file);
+                    if (fs.existsSync(file + '.svmcache')){ fs.unlinkSync(file + '.svmcache'); }
+                }).done(done);
+        });
+    });
+    describe('with or without cache', function () {
+        var read2 = function (file) {
+            return read(file).then(function (parsed) {
+                return read(file, { cache: true }).then(function (cached) {
+                    return [parsed, cached];
+                });
+            }).fin(function () {
+                if (fs.existsSync(file + '.svmcache')){ fs.unlinkSync(file + '.svmcache'); }
+            });
+        };
+        it('should read the same regression examples, keeping decimal labels', function (done) {
+            read2('./examples/datasets/housing.ds')
+                .spread(function (parsed, cached) {
+                    expect(parsed.length).to.be(506);
+                    expect(parsed[1][1]).to.be(21.6);
+                    expect(cached).to.eql(parsed);
+                }).done(done);
+        });
+        it('should read CSV files as CSV', function (done) {
+            var file = path.join(os.tmpdir(), 'node-svm-read-' + process.pid + '.csv');
+            fs.writeFileSync(file, '1.5,0,2\n-1,3,0\n');
+            read2(file)
+                .spread(function (parsed, cached) {
+                    expect(parsed).to.eql([[[0, 2], 1.5], [[3, 0], -1]]);
+                    expect(cached).to.eql(parsed);
+                })
+                .fin(function () {
+                    fs.unlinkSync(file);
+                }).done(done);
+        });
     });
     describe('json format', function () {
         it('should be able to read the xor problem', function (done) {